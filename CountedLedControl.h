@@ -0,0 +1,25 @@
+// LedControl, with a count of the bytes it shifts out to the MAX7219 chain, for the bus accounting (BUS_ACCOUNTING).
+// Each LedControl write shifts 2 bytes through every chip in the chain, whichever chip it's for,
+// and a clear, or a column write, is 8 writes.
+// The methods hide LedControl's, they don't override them, so only writes made through 'lc' itself are counted.
+
+// LED bus bytes shifted out since loop() last logged them.
+unsigned long ledBusBytes = 0;
+
+class CountedLedControl : public LedControl {
+  public:
+    CountedLedControl(int dataPin, int clkPin, int csPin, int numDevices)
+      : LedControl(dataPin, clkPin, csPin, numDevices), chainBytes(numDevices * 2) {}
+    void shutdown(int addr, bool status) { Count(1); LedControl::shutdown(addr, status); }
+    void setScanLimit(int addr, int limit) { Count(1); LedControl::setScanLimit(addr, limit); }
+    void setIntensity(int addr, int intensity) { Count(1); LedControl::setIntensity(addr, intensity); }
+    void clearDisplay(int addr) { Count(8); LedControl::clearDisplay(addr); }
+    void setLed(int addr, int row, int col, boolean state) { Count(1); LedControl::setLed(addr, row, col, state); }
+    void setRow(int addr, int row, byte value) { Count(1); LedControl::setRow(addr, row, value); }
+    void setColumn(int addr, int col, byte value) { Count(8); LedControl::setColumn(addr, col, value); }
+    void setDigit(int addr, int digit, byte value, boolean dp) { Count(1); LedControl::setDigit(addr, digit, value, dp); }
+    void setChar(int addr, int digit, char value, boolean dp) { Count(1); LedControl::setChar(addr, digit, value, dp); }
+  private:
+    byte chainBytes;
+    void Count(byte writes) { ledBusBytes += writes * chainBytes; }
+};
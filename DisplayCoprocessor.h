@@ -0,0 +1,114 @@
+// Display coprocessor link, see DISPLAY_COPROC. The frame layout is shared by both sides, the functions
+// here are the sending side (DISPLAY_COPROC 1), the receiving side is the DISPLAY COPROCESSOR section of the sketch.
+// The lane LED bars, start light, and bargraph are wired to a 2nd board, the coprocessor, and this controller
+// sends it commands over the UART TX pin, instead of driving them itself. See the 'coprocCmds' enum.
+// Text, numbers, and clocks are sent whole, and formatted on the coprocessor, so each is 1 short frame
+// instead of a bus write per digit. A running lap clock is sent once, with the time already elapsed,
+// and the coprocessor keeps it running, so a lane only sends a frame per lap, not per display tick.
+//
+// Frame layout: SOF, command, payload size, payload, checksum (sum of the bytes after the SOF).
+// The link is 1 way, 'Serial' is used as is, and a frame is only held up if Serial's send buffer is full.
+
+const byte coprocSOF = 0x5A;
+const byte coprocMaxPayload = 24;
+
+// Set while the coprocessor is running a lane's clock. Any other write to the bar stops it there, so it's cleared here too.
+bool coprocClockRunning[LANE_COUNT] = {};
+
+void CoprocSend(coprocCmds cmd, const byte payload[], byte size) {
+  if (size > coprocMaxPayload) size = coprocMaxPayload;
+  byte sum = cmd + size;
+  for (byte i = 0; i < size; i++) sum += payload[i];
+  Serial.write(coprocSOF);
+  Serial.write(cmd);
+  Serial.write(size);
+  Serial.write(payload, size);
+  Serial.write(sum);
+  #if BUS_ACCOUNTING
+    // Counted as LED bus bytes, so the Race budget compares with driving the bars directly.
+    ledBusBytes += size + 4;
+  #endif
+}
+
+void CoprocPut32(byte buf[], byte idx, unsigned long value) {
+  for (byte i = 0; i < 4; i++) buf[idx + i] = value >> (8 * i);
+}
+
+void CoprocUnitWritten(byte unit) {
+  if (unit < LANE_COUNT) coprocClockRunning[unit] = false;
+}
+
+void CoprocSpan(byte unit, int posStart, int posEnd, char c) {
+  CoprocUnitWritten(unit);
+  byte payload[4] = {unit, (byte)posStart, (byte)posEnd, (byte)c};
+  CoprocSend(CpSpan, payload, 4);
+}
+
+void CoprocText(byte unit, const char text[], byte endPos, byte width, bool rightJust, bool clear) {
+  CoprocUnitWritten(unit);
+  byte payload[coprocMaxPayload];
+  payload[0] = unit;
+  payload[1] = endPos;
+  payload[2] = width;
+  payload[3] = (rightJust ? 1 : 0) | (clear ? 2 : 0);
+  byte size = 4;
+  while (*text && size < coprocMaxPayload) payload[size++] = *text++;
+  CoprocSend(CpText, payload, size);
+}
+
+void CoprocNumber(byte unit, unsigned long number, byte width, byte endPos, bool leadingZs, bool endWithDecimal) {
+  CoprocUnitWritten(unit);
+  byte payload[8] = {unit};
+  CoprocPut32(payload, 1, number);
+  payload[5] = width;
+  payload[6] = endPos;
+  payload[7] = (leadingZs ? 1 : 0) | (endWithDecimal ? 2 : 0);
+  CoprocSend(CpNumber, payload, 8);
+}
+
+void CoprocClock(byte unit, unsigned long timeMillis, byte endPos, byte width, byte precision, bool leadingZs) {
+  CoprocUnitWritten(unit);
+  byte payload[9] = {unit};
+  CoprocPut32(payload, 1, timeMillis);
+  payload[5] = endPos;
+  payload[6] = width;
+  payload[7] = precision;
+  payload[8] = leadingZs;
+  CoprocSend(CpClock, payload, 9);
+}
+
+// Starts the coprocessor running a lane's clock from 'elapsedMillis'. The link's delay, under 1ms, isn't made up.
+void CoprocClockRun(byte unit, unsigned long elapsedMillis, byte endPos, byte width, byte precision) {
+  byte payload[8] = {unit};
+  CoprocPut32(payload, 1, elapsedMillis);
+  payload[5] = endPos;
+  payload[6] = width;
+  payload[7] = precision;
+  CoprocSend(CpClockRun, payload, 8);
+  if (unit < LANE_COUNT) coprocClockRunning[unit] = true;
+}
+
+void CoprocBar(byte color, byte end, byte start) {
+  byte payload[3] = {color, end, start};
+  CoprocSend(CpBar, payload, 3);
+}
+
+// Stands in for LedControl, with the calls the controller makes, sending each to the coprocessor's LedControl.
+class CoprocLedControl {
+  public:
+    CoprocLedControl(int /*dataPin*/, int /*clkPin*/, int /*csPin*/, int numDevices) : devices(numDevices) {}
+    int getDeviceCount() { return devices; }
+    void shutdown(int addr, bool status) { Send(addr, CpLedShutdown, status); }
+    void setIntensity(int addr, int intensity) { Send(addr, CpLedIntensity, intensity); }
+    void clearDisplay(int addr) { Send(addr, CpLedClear); }
+    void setLed(int addr, int row, int col, boolean state) { Send(addr, CpLedSet, row, col, state); }
+    void setRow(int addr, int row, byte value) { Send(addr, CpLedRow, row, value); }
+    void setDigit(int addr, int digit, byte value, boolean dp) { Send(addr, CpLedDigit, digit, value, dp); }
+  private:
+    int devices;
+    void Send(byte addr, coprocLedOps op, byte a = 0, byte b = 0, byte c = 0) {
+      CoprocUnitWritten(addr);
+      byte payload[5] = {addr, op, a, b, c};
+      CoprocSend(CpLedRaw, payload, 5);
+    }
+};
@@ -0,0 +1,374 @@
+// Display drivers, and the text, number, and clock formatting that's written through them.
+// The formatting functions are templates on the driver, so each display type gets its own copy,
+// with the driver's calls and layout rules resolved when compiled, instead of checked on every character.
+// This file is included after the 'lcd' and 'lc' objects are declared.
+//
+// A driver is a struct of static functions. 'unit' selects 1 of several identical displays (ie. a lane's LED bar),
+// and 'line' a row of a multi line display. A driver ignores whichever of the two it doesn't have.
+// Positions are always indexed left to right, starting at 0.
+//   markCells   - true if ':' and '.' take their own character space, false if they're a digit's decimal point.
+//   writesBlanks - true if blanked leading zeros are written as spaces, false if they're skipped over.
+//   Span(unit, line, posStart, posEnd, c)  - writes character 'c' to every position from start to end, inclusive.
+//   Char(unit, line, pos, c)               - writes a character.
+//   Digit(unit, line, pos, digit, dp)      - writes a 0-9 digit, with its decimal point lit if 'dp' is true.
+//                                            Only used with 'dp' on displays without 'markCells'.
+//   scrolls     - true if text longer than its space is scrolled through it, false if it's cut to fit.
+//   Scroll(unit, line, text, startPos, width) - starts scrolling text through the space, if 'scrolls'.
+//
+// Another display type, such as an OLED, is added by writing its driver,
+// and pointing the 'MainDisplay' or 'LaneDisplay' typedef at it.
+
+
+// Main LCD character display, driven by 'lcd'.
+struct LcdDriver {
+  static const bool markCells = true;
+  static const bool writesBlanks = true;
+  static const bool scrolls = false;
+
+  static void Span(byte /*unit*/, byte line, int posStart, int posEnd, char c) {
+    lcd.setCursor(posStart, line);
+    for (int n = posStart; n <= posEnd; n++) lcd.print(c);
+  }
+  static void Char(byte /*unit*/, byte line, byte pos, char c) {
+    lcd.setCursor(pos, line);
+    lcd.print(c);
+  }
+  static void Digit(byte /*unit*/, byte line, byte pos, byte digit, bool /*dp*/) {
+    lcd.setCursor(pos, line);
+    lcd.print(digit);
+  }
+  static void Scroll(byte /*unit*/, byte /*line*/, const char /*text*/[], byte /*startPos*/, byte /*width*/) {}
+};
+
+// ***** LANE LED MARQUEE *****
+// A name too long for its space on a lane's LED bar is scrolled through it.
+// The name's segment patterns are cached when it's printed. The 1kHz Timer1 tick steps the scroll,
+// and loop() only redraws a bar when its scroll has stepped, so it doesn't cost anything between steps.
+// Any other write to the bar, such as its lap clock, stops its marquee.
+const byte marqueeGap = 2;  // blank spaces scrolled between the end of the name and its restart
+byte marqueeSegs[LANE_COUNT][MARQUEE_CHARS];
+// # of cached characters in each bar's marquee, 0 = no marquee.
+volatile byte marqueeLen[LANE_COUNT] = {};
+byte marqueeStartPos[LANE_COUNT];
+byte marqueeWidth[LANE_COUNT];
+// Scroll step of each marquee, set by the tick, and the step last drawn.
+volatile byte marqueeStep[LANE_COUNT];
+byte marqueeShown[LANE_COUNT];
+volatile bool marqueeDue = false;
+unsigned int marqueeTicks = 0;
+
+bool MarqueeActive() {
+  for (byte u = 0; u < LANE_COUNT; u++) {
+    if (marqueeLen[u]) return true;
+  }
+  return false;
+}
+
+byte SegmentPattern(char c) {
+  return pgm_read_byte(&segmentFont[c & 0x7F]);
+}
+
+// Called from the Timer1 interrupt, every 1ms.
+void MarqueeTick() {
+  if (++marqueeTicks < MARQUEE_STEP_MS) return;
+  marqueeTicks = 0;
+  for (byte u = 0; u < LANE_COUNT; u++) {
+    if (marqueeLen[u] == 0) continue;
+    marqueeStep[u] = (marqueeStep[u] + 1) % (marqueeLen[u] + marqueeGap);
+    marqueeDue = true;
+  }
+}
+
+void MarqueeDraw() {
+  marqueeDue = false;
+  for (byte u = 0; u < LANE_COUNT; u++) {
+    byte len = marqueeLen[u];
+    byte step = marqueeStep[u];
+    if (len == 0 || step == marqueeShown[u]) continue;
+    marqueeShown[u] = step;
+    for (byte i = 0; i < marqueeWidth[u]; i++) {
+      byte c = (step + i) % (len + marqueeGap);
+      lc.setRow(u, (LED_DIGITS - 1) - (marqueeStartPos[u] + i), c < len ? marqueeSegs[u][c] : 0);
+    }
+  }
+}
+
+// MAX7219 8 digit, 7-segment, LED bars, driven by 'lc'. Each bar is a unit, its chip # in the chain.
+// The MAX7219 indexes its digits right to left, so positions are flipped.
+// Characters are drawn from 'segmentFont', not LedControl's table, which has no 'K', 'M', 'V', 'W', or 'X'.
+struct LedDriver {
+  static const bool markCells = false;
+  static const bool writesBlanks = false;
+  static const bool scrolls = true;
+
+  static void Span(byte unit, byte /*line*/, int posStart, int posEnd, char c) {
+    MarqueeStop(unit);
+    byte segs = SegmentPattern(c);
+    for (int i = posStart; i <= posEnd; i++) lc.setRow(unit, (LED_DIGITS - 1) - i, segs);
+  }
+  static void Char(byte unit, byte /*line*/, byte pos, char c) {
+    MarqueeStop(unit);
+    lc.setRow(unit, (LED_DIGITS - 1) - pos, SegmentPattern(c));
+  }
+  static void Digit(byte unit, byte /*line*/, byte pos, byte digit, bool dp) {
+    MarqueeStop(unit);
+    lc.setDigit(unit, (LED_DIGITS - 1) - pos, digit, dp);
+  }
+  // Names longer than MARQUEE_CHARS are cut to MARQUEE_CHARS.
+  static void Scroll(byte unit, byte /*line*/, const char text[], byte startPos, byte width) {
+    if (unit >= LANE_COUNT) return;
+    byte len = strlen(text);
+    if (len > MARQUEE_CHARS) len = MARQUEE_CHARS;
+    // The tick leaves the marquee alone while it's set up.
+    marqueeLen[unit] = 0;
+    for (byte i = 0; i < len; i++) marqueeSegs[unit][i] = SegmentPattern(text[i]);
+    marqueeStartPos[unit] = startPos;
+    marqueeWidth[unit] = width;
+    marqueeStep[unit] = 0;
+    marqueeShown[unit] = 255;
+    marqueeLen[unit] = len;
+    // Draw the start of the name now, rather than on the next loop.
+    MarqueeDraw();
+  }
+
+  static void MarqueeStop(byte unit) {
+    if (unit < LANE_COUNT) marqueeLen[unit] = 0;
+  }
+};
+
+#if DISPLAY_COPROC == 3
+// Stand-in for the LED bars on a test coprocessor, see DISPLAY_COPROC.
+// Each bar is kept as text, which is printed to the serial terminal when it changes.
+char termBars[LED_BAR_COUNT][LED_DIGITS];
+bool termDps[LED_BAR_COUNT][LED_DIGITS];
+bool termChanged = false;
+
+struct TermDriver {
+  static const bool markCells = false;
+  static const bool writesBlanks = false;
+  static const bool scrolls = false;
+
+  static void Span(byte unit, byte line, int posStart, int posEnd, char c) {
+    for (int i = posStart; i <= posEnd; i++) Char(unit, line, i, c);
+  }
+  static void Char(byte unit, byte /*line*/, byte pos, char c) {
+    if (unit >= LED_BAR_COUNT || pos >= LED_DIGITS) return;
+    termBars[unit][pos] = c;
+    termDps[unit][pos] = false;
+    termChanged = true;
+  }
+  static void Digit(byte unit, byte line, byte pos, byte digit, bool dp) {
+    Char(unit, line, pos, '0' + digit);
+    if (unit < LED_BAR_COUNT && pos < LED_DIGITS) termDps[unit][pos] = dp;
+  }
+  static void Scroll(byte /*unit*/, byte /*line*/, const char /*text*/[], byte /*startPos*/, byte /*width*/) {}
+};
+#endif
+
+// The driver of the main display, 'lcdDisp', and of each lane's display, 'led1Disp' to 'led4Disp'.
+typedef LcdDriver MainDisplay;
+#if DISPLAY_COPROC == 3
+  typedef TermDriver LaneDisplay;
+#else
+  typedef LedDriver LaneDisplay;
+#endif
+
+
+template <class Disp>
+void PrintSpanOn(byte unit, byte line, int posStart, int posEnd, char printChar) {
+  Disp::Span(unit, line, posStart, posEnd, printChar);
+}
+
+
+// See PrintNumbers() for the parameters.
+template <class Disp>
+void PrintNumbersOn(byte unit, const unsigned long numberIN, const byte width, const byte endPosIdx, bool leadingZs, const byte line, bool endWithDecimal) {
+  // we take 1 away from width because the endposition is inclusive in the width count
+  byte cursorStartPos = endPosIdx - (width - 1);
+  byte cursorEndPos = endPosIdx;
+  byte digitValue;
+  // variable to track present digit by its place value
+  byte placeValue = width - 1;
+  // written to screen from max place value to min defined by width and end position
+  for (byte displayIdx = cursorStartPos; displayIdx <= cursorEndPos; displayIdx++) {
+    // print current place value's digit
+    digitValue = numberIN / ipow(10, placeValue) % 10;
+    if (!leadingZs && digitValue == 0){
+      if (Disp::writesBlanks) Disp::Char(unit, line, displayIdx, ' ');
+    }
+    else {
+      Disp::Digit(unit, line, displayIdx, digitValue, !Disp::markCells && endWithDecimal && displayIdx == cursorEndPos);
+      // once we get non-zero digit then we want all zeros
+      leadingZs = true;
+    }
+    placeValue--;
+  }
+  if (Disp::markCells && endWithDecimal) Disp::Char(unit, line, cursorEndPos + 1, '.');
+}
+
+
+// See PrintText() for the parameters.
+template <class Disp>
+void PrintTextOn(byte unit, const char textToWrite[], const byte writeSpaceEndPos, const byte width, bool rightJust, const byte line, bool clear) {
+  // Even if text is right justified, available space is filled starting with 1st character.
+  // Need to track the character index seperately from display digit position.
+  byte const textLength = strlen(textToWrite);
+  // We take 1 away from width because the endposition is inclusive in the width count.
+  byte cursorStartPos = writeSpaceEndPos - (width - 1);
+  byte cursorEndPos = writeSpaceEndPos;
+  // Text too long for its space is scrolled, by displays that can.
+  if (Disp::scrolls && textLength > width) {
+    Disp::Scroll(unit, line, textToWrite, cursorStartPos, width);
+    return;
+  }
+  // Adjust start and end positions based on text length and available space.
+  if (textLength < width && rightJust) cursorStartPos = cursorEndPos - (textLength - 1);
+  if (textLength < width && !rightJust) cursorEndPos = cursorEndPos - (width - textLength);
+  // For clearing we want to clear the whole space so we don't use adjusted positions.
+  if (clear) Disp::Span(unit, line, (writeSpaceEndPos-width+1), writeSpaceEndPos, ' ');
+  // Because the writing position index may not match the text char index
+  // we nust track them seperately.
+  byte textIndex = 0;
+  for (byte i = cursorStartPos; i <= cursorEndPos; i++){
+    Disp::Char(unit, line, i, textToWrite[textIndex]);
+    textIndex++;
+  }
+}
+
+
+// See PrintClock() for the parameters.
+template <class Disp>
+void PrintClockOn(byte unit, unsigned long timeMillis, byte clockEndPos, byte printWidth, byte precision, byte line, bool leadingZs) {
+
+  clockWidth nextTimeBlock = H;
+  // # of whole unit digits, and ':' between them, needed for the time.
+  byte digits = 0;
+  byte colons = 0;
+
+  // Based on the time value, calculate the min width needed for the whole units HH:MM:SS.
+  // If t < 10sec, 0.0
+  if (timeMillis < 10000){
+    nextTimeBlock = S;
+    digits = 1;
+  } else
+  // if 10sec <= t < 1min, 00
+  if (timeMillis < 60000){
+    nextTimeBlock = S;
+    digits = 2;
+  } else
+  // if 1min <= t < 10min, 0:00
+  if (timeMillis < 600000){
+    nextTimeBlock = M;
+    digits = 3;
+    colons = 1;
+  } else
+  // if 10min <= t < 1hr, 00:00
+  if (timeMillis < 3600000){
+    nextTimeBlock = M;
+    digits = 4;
+    colons = 1;
+  } else
+  // if 1hr <= t < 10hr, 0:00:00
+  if (timeMillis < 36000000){
+    nextTimeBlock = H;
+    digits = 5;
+    colons = 2;
+  } else
+  // if 10hr <= t < 24hr, 00:00:00
+  if (timeMillis < 86400000){
+    nextTimeBlock = H;
+    digits = 6;
+    colons = 2;
+  }
+
+  // 'baseTimeWidth' is min width needed for the whole units HH:MM:SS, and their colons if they take a space.
+  byte baseTimeWidth = digits + (Disp::markCells ? colons : 0);
+  // Calculate how many decimal places can be accomodated in the display area (printWidth).
+  // If the display needs a character space for the '.', we must adjust the required width accordingly.
+  // Over the max clock limit of 24 hrs, there's never space.
+  int maxPrecision = (digits == 0 ? -1 : printWidth - baseTimeWidth - (Disp::markCells ? 1 : 0));
+
+  // A negative maxPrecision means we don't have space to print the time.
+  if (maxPrecision < 0){
+    // Print an 'E' to alert current time is over display width limit.
+    PrintTextOn<Disp>(unit, "E", clockEndPos, printWidth, true, line, Disp::writesBlanks);
+    return;
+  }
+
+  unsigned long ulHour;
+  unsigned long ulMin;
+  unsigned long ulSec;
+  unsigned long ulDec;
+  unsigned long ulCent;
+  unsigned long ulMill;
+  // Convert millisecond time into its individual time blocks.
+  SplitTime(timeMillis, ulHour, ulMin, ulSec, ulDec, ulCent, ulMill);
+  unsigned long decimalSec;
+
+  // if requested precision is higher than available max, use max.
+  precision = maxPrecision < precision ? maxPrecision : precision;
+  // Position of the last hour digit, as if there were 2. Where ':' and '.' take a space, it must be added for them.
+  byte hourEndPos = clockEndPos - (4 + precision + (Disp::markCells ? 2 + (precision > 0 ? 1 : 0) : 0));
+
+  // If leading zeros are requested but there is no space turn them off.
+  // If the '.' takes a space, with precision, subtract additional 1 for the decimal position.
+  if( (printWidth - precision - baseTimeWidth - ((Disp::markCells && precision>0)?1:0)) <= 0 ){
+    leadingZs = false;
+  }
+
+  // calculate total width needed to print time string
+  // Must account for end position being included in the printWidth total.
+  byte totalWidth = baseTimeWidth + precision + (Disp::markCells ? 1 : 0);
+  // Clear spaces in print width that occur before clock time's first display digit
+  Disp::Span(unit, line, clockEndPos - printWidth +1, clockEndPos - totalWidth, ' ');
+
+  // Set which precision time block to use based on available precision.
+  switch(precision){
+    case 1:
+      decimalSec = ulDec;
+    break;
+    case 2:
+      decimalSec = ulCent;
+    break;
+    case 3:
+      decimalSec = ulMill;
+    break;
+    default:
+      decimalSec = 0;
+    break;
+  }
+
+  // Where ':' doesn't take a space, the decimal point of the digit before it is lit instead.
+  if (nextTimeBlock == H) {
+    // H 00:00:00
+    PrintNumbersOn<Disp>(unit, ulHour, 2, hourEndPos, leadingZs, line, !Disp::markCells);
+    if (Disp::markCells) Disp::Char(unit, line, hourEndPos + 1, ':');
+    // All non-leading parts of the clock time should have leading zeros
+    leadingZs = true;
+    // Move on to print Minutes.
+    nextTimeBlock = M;
+  }
+
+  if (nextTimeBlock == M) {
+    // M 00:00
+    byte minEndPos = hourEndPos + (Disp::markCells ? 3 : 2);
+    PrintNumbersOn<Disp>(unit, ulMin, 2, minEndPos, leadingZs, line, !Disp::markCells);
+    if (Disp::markCells) Disp::Char(unit, line, minEndPos + 1, ':');
+    // All non-leading parts of the clock time should have leading zeros
+    leadingZs = true;
+    // Move on to print seconds
+    nextTimeBlock = S;
+  }
+
+  if (nextTimeBlock == S) {
+    byte pwidth = 2;
+    // if the input time is under 1sec then use only 1 digit width leading zero
+    if (timeMillis < 1000) {
+      leadingZs = true;
+      pwidth = 1;
+    }
+    // S 00.(000)
+    PrintNumbersOn<Disp>(unit, ulSec, pwidth, hourEndPos + (Disp::markCells ? 6 : 4), leadingZs, line, precision > 0);
+    if(precision > 0) PrintNumbersOn<Disp>(unit, decimalSec, precision, clockEndPos, true, line, false);
+  }
+}
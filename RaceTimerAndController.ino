@@ -5,15 +5,6 @@
 // enums are kept in a seperate file to force them to compile early so they can be used in functions
 #include "enum_lists.h"
 
-// Enable if using RTTL type song/melody data for playing sounds
-//-------------------
-// library for playing RTTTL song types
-#include <PlayRtttl.h>
-// file of RTTTL song definition strings.
-// Because these strings are stored in PROGMEM we must also include 'avr/pgmspace.h' to access them.
-#include "RTTTL_songs.h"
-//-------------------
-
 // Enable if using Note-Lengths Array method of playing Arduino sounds
 // //-------------------
 // // Defines the note constants that make up a melodie's Notes[] array.
@@ -25,26 +16,352 @@
 
 // Library to support storing/accessing constant variables in PROGMEM
 #include <avr/pgmspace.h>
+// Sleep modes and watchdog timer, used to idle the controller between key presses.
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+// EEPROM access and CRC, used to checkpoint a live race.
+#include <avr/eeprom.h>
+#include <util/crc16.h>
 
-// The 'Wire' library is for I2C, and is included in the Arduino installation.
-// Specific implementation is determined by the board selected in Arduino IDE.
-#include <Wire.h>
-// LCD driver libraries
-#include <hd44780.h>						            // main hd44780 header file
-#include <hd44780ioClass/hd44780_I2Cexp.h>	// i/o class header for i2c expander backpack
+// load default and local settings that define menu text and default race controller attributes.
+// The settings are loaded before the display libraries, because I2C_ASYNC determines which are used.
+#include "defaultSettings.h"
+
+// Enable if using RTTL type song/melody data for playing sounds
+// They're left out of a build without audio, BUILD_AUDIO.
+//-------------------
+#if BUILD_AUDIO
+  // library for playing RTTTL song types
+  #include <PlayRtttl.h>
+  // file of RTTTL song definition strings.
+  // Because these strings are stored in PROGMEM we must also include 'avr/pgmspace.h' to access them.
+  #include "RTTTL_songs.h"
+#else
+  // Without audio, the song player calls made outside of PlayVictorySong() are defined away.
+  #define updatePlayRtttl() false
+  #define stopPlayRtttl()
+#endif
+//-------------------
+#if !BUILD_CIRCUIT && !BUILD_DRAG
+  #error "BUILD_CIRCUIT and BUILD_DRAG can't both be false, there would be no races to run."
+#endif
+// Note what the build profile has left out in the compiler output. The IDE's 'Sketch uses' and 'Global variables use'
+// lines, compared against a full build, give the flash and SRAM each saves.
+#if !BUILD_CIRCUIT
+  #pragma message "Build profile: circuit (Standard & Timed) races compiled out"
+#endif
+#if !BUILD_DRAG
+  #pragma message "Build profile: drag races compiled out"
+#endif
+#if !BUILD_AUDIO
+  #pragma message "Build profile: RTTTL player, songs, and beeps compiled out"
+#endif
+#if !BUILD_BARGRAPH
+  #pragma message "Build profile: Adafruit bargraph start light compiled out"
+#endif
+
+#if !I2C_ASYNC
+  // The 'Wire' library is for I2C, and is included in the Arduino installation.
+  // Specific implementation is determined by the board selected in Arduino IDE.
+  // It can't be included with I2C_ASYNC, because both would define the I2C interrupt.
+  #include <Wire.h>
+  // LCD driver libraries
+  #include <hd44780.h>						            // main hd44780 header file
+  #include <hd44780ioClass/hd44780_I2Cexp.h>	// i/o class header for i2c expander backpack
+#endif
 // Custom character layout Byte's for LCD
 #include "CustomChars.h"
 // library for 7-seg LED Bars
 #include <LedControl.h>
+// Segment patterns of each character for the LED bars
+#include "SegmentFont.h"
+#if BUS_ACCOUNTING
+  #include "CountedLedControl.h"
+#endif
+#if DISPLAY_COPROC
+  #include "DisplayCoprocessor.h"
+#endif
 
 // Library to support 4 x 4 keypad
 #include <Keypad.h>
 
-// load default and local settings that define menu text and default race controller attributes.
-#include "defaultSettings.h"
+
+#if I2C_ASYNC
+// --------- I2C TRANSMIT QUEUE --------------------------
+// Writes to the LCD and bargraph are put in a ring buffer queue, and return right away.
+// The bytes are then sent by the TWI (I2C) interrupt, one per interrupt, while loop() carries on.
+// Each queued transaction is a header byte, a length byte, then that many payload bytes.
+// The header is the 7 bit device address, with the top bit set if the device is the LCD's PCF8574 expander.
+// For the expander, each payload byte is an LCD character, that the interrupt splits into
+// the 4 bus bytes needed to clock it into the LCD, 4 bits at a time. A 0 byte is an escape,
+// meaning the next byte is an LCD command, or if the next byte is also 0, the character 0.
+const byte twiQueueSize = I2C_QUEUE_SIZE;
+volatile byte twiQueue[twiQueueSize];
+// Idx of where the next queued byte will go, and of the next byte to be sent.
+// The queue is empty when they are equal.
+volatile byte twiHead = 0;
+volatile byte twiTail = 0;
+// Idx of the header of the last queued transaction, until the interrupt starts sending it.
+// Until then, more bytes for the same device are added to it instead of starting a new transaction.
+// 255 when there isn't one.
+volatile byte twiOpenIdx = 255;
+// true from when a transaction is started, until the queue is empty and a stop has been sent.
+volatile bool twiBusy = false;
+// Payload bytes left in the transaction being sent.
+volatile byte twiTxLeft = 0;
+// Expander byte being sent, its RS bit, and which of its 4 bus bytes is next, counting down.
+volatile byte twiTxByte = 0;
+volatile byte twiTxRS = 0;
+volatile byte twiNibblePhase = 0;
+volatile bool twiExpander = false;
+// # of idle bus bytes to send to the expander, to give the LCD time to execute a clear or home.
+volatile byte twiHoldBytes = 0;
+// Low priority writes are dropped if this many bytes aren't free after the write.
+const byte twiLowReserve = twiQueueSize / 4;
+// Priority applied to queued writes, and if a low priority write has been dropped.
+// Once one is dropped, the rest of the low priority writes are dropped too,
+// until the priority is set again, so a partial update is never written.
+twiPriority twiWritePriority = TwiNormal;
+bool twiLowDropping = false;
+// Counts of dropped low priority writes, and of transactions not acknowledged by their device.
+unsigned int twiDropCount = 0;
+volatile unsigned int twiErrorCount = 0;
+// Ms without the queue moving, after which the bus is considered hung and is reset.
+const byte twiHungMillis = 20;
+#if BUS_ACCOUNTING
+// Bus bytes sent, including addresses, and transactions started, since loop() last logged them.
+volatile unsigned int twiBusBytes = 0;
+volatile unsigned int twiBusStarts = 0;
+#endif
+
+// PCF8574 expander bits wired to the LCD
+const byte twiExpanderFlag = 0x80;
+const byte lcdRS = 0x01;
+const byte lcdEN = 0x04;
+const byte lcdBacklight = 0x08;
+// Idle expander bytes sent after an LCD clear or home, to cover its 1.52ms execution time.
+// Each bus byte takes 9 clocks, this is just over 2ms worth.
+const byte lcdHoldBytes = 2000UL * (I2C_CLOCK / 1000) / 9000 + 1;
+#endif
+
+// Sets the priority of following display writes, and starts a new low priority update.
+// Without I2C_ASYNC, the display writes always go straight to the bus, and there's nothing to prioritize.
+void SetTwiPriority(twiPriority priority) {
+  #if I2C_ASYNC
+    twiWritePriority = priority;
+    twiLowDropping = false;
+  #else
+    (void)priority;
+  #endif
+}
+
+#if I2C_ASYNC
+// Sets the TWI hardware to the I2C_CLOCK bus speed, with the internal pull-ups on SDA and SCL.
+void TwiSetup() {
+  digitalWrite(SDA, HIGH);
+  digitalWrite(SCL, HIGH);
+  TWSR = 0;
+  TWBR = ((F_CPU / I2C_CLOCK) - 16) / 2;
+  TWCR = bit(TWEN);
+}
+
+// # of free bytes in the queue, one is always left empty so full and empty can be told apart.
+byte TwiFree() {
+  byte used = (twiHead >= twiTail ? twiHead - twiTail : twiHead + twiQueueSize - twiTail);
+  return twiQueueSize - 1 - used;
+}
+
+// Waits until the interrupt has sent some of the queue.
+// If the queue hasn't moved in twiHungMillis, the bus is reset, the queue emptied, and false returned.
+bool TwiWait() {
+  byte tail = twiTail;
+  unsigned long waitStart = millis();
+  while (tail == twiTail && twiBusy) {
+    if (millis() - waitStart > twiHungMillis) {
+      noInterrupts();
+      TWCR = 0;
+      twiHead = twiTail = 0;
+      twiOpenIdx = 255;
+      twiTxLeft = twiNibblePhase = twiHoldBytes = 0;
+      twiBusy = false;
+      twiErrorCount++;
+      TWCR = bit(TWEN);
+      interrupts();
+      return false;
+    }
+  }
+  return true;
+}
+
+// Waits until the queue is sent.
+void TwiFlush() {
+  while (twiBusy && TwiWait());
+}
+
+// Queues 'count' payload bytes for the device 'header', starting the interrupt if it's idle.
+// If there isn't room, a low priority write is dropped and false returned, any other write waits.
+bool TwiQueueWrite(byte header, const byte data[], byte count) {
+  bool join;
+  while (true) {
+    noInterrupts();
+    // Only LCD writes are joined, other devices would take the extra bytes as part of the 1st write.
+    join = ((header & twiExpanderFlag) && twiOpenIdx != 255 && twiQueue[twiOpenIdx] == header &&
+            twiQueue[(twiOpenIdx + 1) % twiQueueSize] <= 255 - count);
+    byte needed = count + (join ? 0 : 2) + (twiWritePriority == TwiLow ? twiLowReserve : 0);
+    if (!(twiWritePriority == TwiLow && twiLowDropping) && TwiFree() >= needed) break;
+    interrupts();
+    if (twiWritePriority == TwiLow) {
+      twiLowDropping = true;
+      twiDropCount++;
+      return false;
+    }
+    if (!TwiWait()) return false;
+  }
+  // Interrupts are off from here, so the interrupt can't start the open transaction while it's added to.
+  byte head = twiHead;
+  if (join) {
+    twiQueue[(twiOpenIdx + 1) % twiQueueSize] += count;
+  } else {
+    twiOpenIdx = head;
+    twiQueue[head] = header;
+    head = (head + 1) % twiQueueSize;
+    twiQueue[head] = count;
+    head = (head + 1) % twiQueueSize;
+  }
+  for (byte i = 0; i < count; i++) {
+    twiQueue[head] = data[i];
+    head = (head + 1) % twiQueueSize;
+  }
+  twiHead = head;
+  if (!twiBusy) {
+    twiBusy = true;
+    TWCR = bit(TWINT) | bit(TWEN) | bit(TWIE) | bit(TWSTA);
+  }
+  interrupts();
+  return true;
+}
+
+// Takes the next byte from the queue, only called by the interrupt.
+byte TwiPop() {
+  byte data = twiQueue[twiTail];
+  twiTail = (twiTail + 1) % twiQueueSize;
+  return data;
+}
+
+// Returns the next of the 4 bus bytes that clock twiTxByte into the LCD.
+// The high 4 bits are sent first, each is set with E high, then latched by setting E low.
+byte TwiNibbleByte() {
+  byte data = (twiNibblePhase > 2 ? twiTxByte & 0xF0 : twiTxByte << 4);
+  data |= twiTxRS | lcdBacklight | (twiNibblePhase % 2 ? 0 : lcdEN);
+  twiNibblePhase--;
+  return data;
+}
+
+// Ends the transaction sent, with a repeated start if another is queued, else a stop.
+void TwiEndTransaction() {
+  if (twiTail != twiHead) {
+    TWCR = bit(TWINT) | bit(TWEN) | bit(TWIE) | bit(TWSTA);
+  } else {
+    TWCR = bit(TWINT) | bit(TWEN) | bit(TWSTO);
+    // The stop takes a few us, it must be finished before another start is requested.
+    while (TWCR & bit(TWSTO));
+    twiBusy = false;
+  }
+}
+
+// TWI interrupt, called each time the hardware has finished a start, or sending a byte.
+ISR(TWI_vect) {
+  switch (TWSR & 0xF8) {
+    // start, or repeated start sent, send the address of the next queued transaction
+    case 0x08: case 0x10: {
+      if (twiTail == twiOpenIdx) twiOpenIdx = 255;
+      byte header = TwiPop();
+      twiTxLeft = TwiPop();
+      #if BUS_ACCOUNTING
+        twiBusStarts++;
+        twiBusBytes++;
+      #endif
+      twiExpander = header & twiExpanderFlag;
+      // 7 bit address + write bit (0)
+      TWDR = (header & 0x7F) << 1;
+      TWCR = bit(TWINT) | bit(TWEN) | bit(TWIE);
+    }
+    break;
+    // address or data byte acknowledged, send the next byte
+    case 0x18: case 0x28: {
+      if (twiNibblePhase) {
+        TWDR = TwiNibbleByte();
+      } else if (twiHoldBytes) {
+        twiHoldBytes--;
+        TWDR = lcdBacklight;
+      } else if (twiTxLeft) {
+        byte data = TwiPop();
+        twiTxLeft--;
+        if (twiExpander) {
+          twiTxRS = lcdRS;
+          if (data == 0) {
+            data = TwiPop();
+            twiTxLeft--;
+            if (data) twiTxRS = 0;
+          }
+          // An LCD clear (1) or home (2-3) command needs time to execute before the next one.
+          if (!twiTxRS && data < 4) twiHoldBytes = lcdHoldBytes;
+          twiTxByte = data;
+          twiNibblePhase = 4;
+          data = TwiNibbleByte();
+        }
+        TWDR = data;
+      } else {
+        TwiEndTransaction();
+        break;
+      }
+      #if BUS_ACCOUNTING
+        twiBusBytes++;
+      #endif
+      TWCR = bit(TWINT) | bit(TWEN) | bit(TWIE);
+    }
+    break;
+    // Not acknowledged, or bus error. Skip the rest of the transaction.
+    default: {
+      twiTail = ((unsigned int)twiTail + twiTxLeft) % twiQueueSize;
+      twiTxLeft = twiNibblePhase = twiHoldBytes = 0;
+      twiErrorCount++;
+      TwiEndTransaction();
+    }
+    break;
+  }
+}
+#endif
+// ------------- END OF I2C TRANSMIT QUEUE ------------------------
 
 
 // --------- I2C ADAFRUIT LED BARGRAPH GLOBAL CODE --------------------------
+#if I2C_ASYNC || !BUILD_BARGRAPH || DISPLAY_COPROC == 1
+// LED colors, as defined by the Adafruit LEDBackpack library.
+#define LED_OFF 0
+#define LED_RED 1
+#define LED_YELLOW 2
+#define LED_GREEN 3
+#endif
+
+#if !BUILD_BARGRAPH
+// Without the bargraph, setBargraph() is left empty, and the start lights are only shown on the MAX7219 tree.
+#elif DISPLAY_COPROC == 1
+// The bargraph is wired to the display coprocessor.
+#elif I2C_ASYNC
+// The bargraph's HT16K33 driver rows 0-2, a bit for each red and green LED.
+uint16_t barRows[3] = {};
+
+// Turns on the HT16K33 oscillator and display, and blanks the bargraph.
+void BargraphSetup() {
+  // oscillator on, display on with no blink, full brightness
+  const byte commands[3] = {0x21, 0x81, 0xEF};
+  for (byte i = 0; i < 3; i++) TwiQueueWrite(BARGRAPH_I2C_ADDRESS, &commands[i], 1);
+  // Blank all 8 rows of the display memory, the bargraph only uses the 1st 3.
+  byte blank[17] = {};
+  TwiQueueWrite(BARGRAPH_I2C_ADDRESS, blank, 17);
+}
+#else
 // Adafruit Bar LED libraries
 // code taken from built in Adafruit LEDBackpack library 'bargraph24)
 #include <Adafruit_GFX.h>
@@ -53,6 +370,7 @@
 
 // declaring object representing Adafruit LED bar, called 'bar'.
 Adafruit_24bargraph bar = Adafruit_24bargraph();
+#endif
 
 // create a global variable to track the 'on' state of LED bar
 // We'll use this flage to make if faster to check status during a race
@@ -63,13 +381,38 @@ bool clearStartLight = false;
 // 'start' is the index reference of 1st LED to change, index 0 is LED 1
 // 'end' is index of last LED to change, index 23 is LED 24
 // by default, leaving 'start' and 'end' out of function call, will set entire bar
+#if !BUILD_BARGRAPH
+void setBargraph(byte /*color*/, byte /*end*/ = 23, byte /*start*/ = 0) {}
+#else
 void setBargraph(byte color, byte end = 23, byte start = 0) {
-  // cyle through each LED to change, set new color, and update display
-  for (uint8_t i=start; i<=end; i++) {
-    bar.setBar(i, color);
+  #if DISPLAY_COPROC == 1
+    CoprocBar(color, end, start);
+  #elif I2C_ASYNC
+    // Same LED to row and bit mapping as Adafruit_24bargraph::setBar()
+    for (uint8_t i=start; i<=end; i++) {
+      byte row = (i < 12 ? i : i - 12) / 4;
+      byte redBit = i % 4 + (i < 12 ? 0 : 4);
+      uint16_t ledBits = (uint16_t)1 << redBit | (uint16_t)1 << (redBit + 8);
+      barRows[row] &= ~ledBits;
+      if (color == LED_RED || color == LED_YELLOW) barRows[row] |= (uint16_t)1 << redBit;
+      if (color == LED_GREEN || color == LED_YELLOW) barRows[row] |= (uint16_t)1 << (redBit + 8);
+    }
+    // Send all 3 rows, from display address 0, as 1 queued frame.
+    byte frame[7] = {0};
+    for (byte row = 0; row < 3; row++) {
+      frame[1 + row * 2] = barRows[row] & 0xFF;
+      frame[2 + row * 2] = barRows[row] >> 8;
+    }
+    TwiQueueWrite(BARGRAPH_I2C_ADDRESS, frame, 7);
+  #else
+    // cyle through each LED to change and set new color, then update display once
+    for (uint8_t i=start; i<=end; i++) {
+      bar.setBar(i, color);
+    }
     bar.writeDisplay();
-  }
+  #endif
 }
+#endif
 // ------------- END OF BARGRAPH GLOBALS ------------------------
 
 
@@ -135,6 +478,21 @@ const byte lanes[5][2] = {
   LANE4
 };
 
+// SECTOR SENSORS
+// Each lane can have one optional, intermediate, sector sensor that splits its lap in two.
+// Sector 1 runs from the lap start to the sector sensor, and sector 2 from the sensor to the lap end.
+// Sector sensors must be on spare pins of the same port as the lane triggers, so they can be
+// decoded from the same port read in the ISR. Rows are {pin, mask}, like lanes[] above.
+// A pin of 255, with a mask of 0, means the lane has no sector sensor.
+// See the 'LANE#_SECTOR' tokens in the 'defaultSettings.h' file or 'localSettings.h' file.
+const byte laneSectors[5][2] = {
+  {255, 0},
+  LANE1_SECTOR,
+  LANE2_SECTOR,
+  LANE3_SECTOR,
+  LANE4_SECTOR
+};
+
 // ---- Alternate Configurations
 // -----------------------------
 
@@ -166,8 +524,20 @@ const byte lanes[5][2] = {
 // This input is expected to be HIGH and go LOW when pressed.
 const byte pauseStopPin = PAUSEPIN;
 const byte startButtonPin = STARTPIN;
-// timestamp marking new press of pause button, used to set start of debounce period.
-unsigned long buttonDebounceMillis = 0;
+// The buttons are sampled in the background by the ADC interrupt, alternating between the two pins.
+// In the button arrays below, idx 0 is the pause button, and idx 1 is the start button.
+// 8 bit ADC readings, below which a button is pressed, and above which it is let go.
+// The gap between them stops a noisy reading from chattering between pressed and not.
+const byte buttonPressLevel = 25;
+const byte buttonReleaseLevel = 50;
+// Debounced state of each button, true while held down.
+volatile bool buttonDown[2] = {};
+// Set by the ADC interrupt on a new press, and cleared when it is read by buttonPressed().
+volatile bool buttonEdge[2] = {};
+// timestamp marking new press of each button, used to set start of its debounce period.
+volatile unsigned long buttonDebounceMillis[2] = {};
+// idx of the button the ADC is sampling.
+volatile byte adcButtonIdx = 0;
 
 //***** Variables for LCD 4x20 Display **********
 // This display communicates using I2C via the SCL and SDA pins,
@@ -176,10 +546,154 @@ unsigned long buttonDebounceMillis = 0;
 // If using Arduino Mega2560, pin D20 can be used for SDA, & pin D21 for SCL.
 // Make sure the LCD is wired accordingly.
 
+#if I2C_ASYNC
+// LCD driver for a PCF8574 i/o expander backpack, that queues its writes to the I2C transmit queue.
+// It has the same API as the hd44780 library, for the functions used by this program.
+class AsyncLCD : public Print {
+  public:
+    AsyncLCD(byte address) : header(address | twiExpanderFlag) {}
+
+    // Sets the LCD to 4 bit mode, and clears it. Unlike the other functions, this waits for the bus.
+    // Returns 0 on success, or 1 if the backpack didn't respond.
+    int begin(byte cols, byte /*rows*/) {
+      lcdCols = cols;
+      unsigned int errorCount = twiErrorCount;
+      delay(50);
+      // The LCD may be in 8 or 4 bit mode at power up, this sequence gets it to 4 bit mode from either.
+      // Each step is a single 4 bit write, sent directly as expander bus bytes.
+      const byte initNibbles[4] = {0x30, 0x30, 0x30, 0x20};
+      for (byte i = 0; i < 4; i++) {
+        byte nibble[2] = {(byte)(initNibbles[i] | lcdBacklight | lcdEN), (byte)(initNibbles[i] | lcdBacklight)};
+        TwiQueueWrite(header & 0x7F, nibble, 2);
+        TwiFlush();
+        delay(5);
+      }
+      // 4 bit, 2 line, 5x8 font
+      Command(0x28);
+      displayControl = 0x0C;
+      Command(displayControl);
+      // left to right entry
+      Command(0x06);
+      clear();
+      TwiFlush();
+      return (twiErrorCount == errorCount ? 0 : 1);
+    }
+
+    // Same as hd44780::fatalError(), blinks the onboard LED 'status' times, over and over, and never returns.
+    static void fatalError(int status) {
+      #if defined ( LED_BUILTIN )
+        pinMode(LED_BUILTIN, OUTPUT);
+        while (true) {
+          for (int i = 0; i < status; i++) {
+            digitalWrite(LED_BUILTIN, HIGH);
+            delay(100);
+            digitalWrite(LED_BUILTIN, LOW);
+            delay(250);
+          }
+          delay(1500);
+        }
+      #else
+        (void)status;
+        while (true) {}
+      #endif
+    }
+
+    void clear() {
+      Command(0x01);
+      cursorAddr = 0;
+    }
+
+    void home() {
+      Command(0x02);
+      cursorAddr = 0;
+    }
+
+    // A cursor move is only sent if the LCD's cursor isn't already there.
+    void setCursor(byte col, byte row) {
+      const byte rowStart[4] = {0x00, 0x40, lcdCols, (byte)(0x40 + lcdCols)};
+      byte addr = rowStart[row % 4] + col;
+      if (addr == cursorAddr) return;
+      Command(0x80 | addr);
+      cursorAddr = addr;
+    }
+
+    void cursor() {
+      displayControl |= 0x02;
+      Command(displayControl);
+    }
+
+    void noCursor() {
+      displayControl &= ~0x02;
+      Command(displayControl);
+    }
+
+    void createChar(byte location, byte charmap[]) {
+      Command(0x40 | ((location & 0x7) << 3));
+      write(charmap, 8);
+      // Writes now go to the character memory, until the cursor is set again.
+      cursorAddr = 255;
+    }
+
+    size_t write(uint8_t character) {
+      return write(&character, 1);
+    }
+
+    // Without this, write(0) would be ambiguous between write(uint8_t) and Print::write(const char*).
+    size_t write(int character) {
+      return write((uint8_t)character);
+    }
+
+    // Characters are queued in chunks, with a 0 character escaped as 0, 0.
+    size_t write(const uint8_t *buffer, size_t size) {
+      byte chunk[16];
+      byte count = 0;
+      for (size_t i = 0; i < size; i++) {
+        if (buffer[i] == 0) chunk[count++] = 0;
+        chunk[count++] = buffer[i];
+        // The LCD moves its cursor to the next character, which wraps to the next display line.
+        if (cursorAddr != 255) {
+          cursorAddr++;
+          if (cursorAddr == 0x28) cursorAddr = 0x40;
+          else if (cursorAddr == 0x68) cursorAddr = 0;
+        }
+        if (count >= sizeof(chunk) - 1 || i == size - 1) {
+          Send(chunk, count);
+          count = 0;
+        }
+      }
+      return size;
+    }
+
+    using Print::write;
+
+  private:
+    // Device address, with the expander flag set.
+    byte header;
+    byte lcdCols = 20;
+    // Display control command, with the display on, and the cursor on or off.
+    byte displayControl = 0x0C;
+    // DDRAM address the LCD's cursor is at, or 255 if it isn't known.
+    byte cursorAddr = 255;
+
+    // Queues an escaped command.
+    void Command(byte command) {
+      byte escaped[2] = {0, command};
+      Send(escaped, 2);
+    }
+
+    // If a write is dropped, the cursor is no longer known.
+    void Send(const byte data[], byte count) {
+      if (!TwiQueueWrite(header, data, count)) cursorAddr = 255;
+    }
+};
+
+AsyncLCD lcd(LCD_I2C_ADDRESS);
+#else
 // Declare 'lcd' object representing display using class 'hd44780_I2Cexp'
 // because we are using the i2c i/o expander backpack (PCF8574 or MCP23008)
 
 hd44780_I2Cexp lcd;
+#endif
 
 // When more than 2 MAX7219s are chained, additional LED bars
 // may need direct power supply to avoid intermittent error.
@@ -189,7 +703,17 @@ const byte LED_BAR_COUNT = LANE_COUNT + 1;
 // # of digits on each LED bar
 const byte LED_DIGITS = 8;
 // LedControl parameters (DataIn, CLK, CS/LOAD, Number of Max chips (ie 8-digit bars))
-LedControl lc = LedControl(PIN_TO_LED_DIN, PIN_TO_LED_CLK, PIN_TO_LED_CS, LED_BAR_COUNT);
+#if DISPLAY_COPROC == 1
+  // The LED bars are wired to the display coprocessor.
+  CoprocLedControl lc = CoprocLedControl(PIN_TO_LED_DIN, PIN_TO_LED_CLK, PIN_TO_LED_CS, LED_BAR_COUNT);
+#elif BUS_ACCOUNTING
+  CountedLedControl lc = CountedLedControl(PIN_TO_LED_DIN, PIN_TO_LED_CLK, PIN_TO_LED_CS, LED_BAR_COUNT);
+#else
+  LedControl lc = LedControl(PIN_TO_LED_DIN, PIN_TO_LED_CLK, PIN_TO_LED_CS, LED_BAR_COUNT);
+#endif
+
+// Display drivers for the print functions, which must come after 'lcd' and 'lc' are declared.
+#include "DisplayDrivers.h"
 
 
 //***** KeyPad Variables *****
@@ -207,12 +731,41 @@ char keys[KP_ROWS][KP_COLS] = {
 byte pin_rows[KP_ROWS] = {5,6,7,8};
 // Establish the column pinouts, {Col1,Col2,Col3,Col4} => Arduino pins 9,10,11,12
 byte pin_column[KP_COLS] = {9,10,11,12}; 
-// Creating keypad object
-Keypad keypad = Keypad( makeKeymap(keys), pin_rows, pin_column, KP_ROWS, KP_COLS );
+#if KEYPAD_INTERRUPTS
+  // The keypad is scanned from a pin change interrupt on its columns, see the KEYPAD DRIVER functions.
+  // Keys are queued by the interrupt, and read from the queue with GetKey().
+  const byte keyQSize = 4;
+  volatile char keyQ[keyQSize];
+  // The ISR only moves the head, and GetKey() only moves the tail.
+  volatile byte keyQHead = 0;
+  volatile byte keyQTail = 0;
+  // The key currently held down, and the millis() timestamp it was let go.
+  volatile char keyHeld = NO_KEY;
+  volatile unsigned long keyReleaseMillis = 0;
+  // A key must be let go for this long (ms) before another press is accepted.
+  const byte keyDebounceTime = 20;
+  // Port registers and bit masks of the row and column pins, looked up once in KeypadSetup().
+  volatile uint8_t *keyRowPort[KP_ROWS];
+  byte keyRowMask[KP_ROWS];
+  volatile uint8_t *keyColPin[KP_COLS];
+  byte keyColMask[KP_COLS];
+#else
+  // Creating keypad object
+  Keypad keypad = Keypad( makeKeymap(keys), pin_rows, pin_column, KP_ROWS, KP_COLS );
+#endif
 
 
 //*** RACE PROPERTIESS ******
-races raceType = Standard;
+#if BUILD_CIRCUIT
+  races raceType = Standard;
+#else
+  // A drag only build has no other race type. As a constant, the compiler drops the code for the others.
+  const races raceType = Drag;
+#endif
+// true if the race is a drag race. Without BUILD_DRAG it's always false, and the drag race code is dropped.
+bool DragRace() {
+  return BUILD_DRAG && raceType == Drag;
+}
 // variable to hold the 'race to' x lap total setting
 int raceLaps = DEFAULT_LAPS;
 // variable indicating final lap of race, most often will equal 'raceLaps' except for drag race.
@@ -243,12 +796,24 @@ unsigned long curMillis;
 // Interval in milliseconds that the clock displays are updated.
 // this value does not affect lap time precision, it only sets min display update rate.
 // This is done to be more efficient and give's us some control over refresh rate.
-int displayTick = DEFAULT_REFRESH_TICKS;
+unsigned int displayTick = DEFAULT_REFRESH_TICKS;
 // timing between start light updates during PreStart
-int preStartTick = 1000;
-int nextStageCountdownTime = 0;
+// These are used by the Timer1 interrupt that runs the start light sequence.
+volatile unsigned int preStartTick = 1000;
+volatile unsigned int nextStageCountdownTime = 0;
 // A millis() timestamp marking last tick completion.
 unsigned long lastTickMillis;
+// millis() timestamp taken by the Timer1 interrupt, on the tick the start lights went green.
+// A new race's clock starts from this, not from the first pass through the Race state.
+volatile unsigned long greenMillis;
+// millis() timestamp a Timed race's clock runs out. The lane interrupts check crossings against it,
+// so a lap crossed after time is up isn't counted, however long loop() takes to notice. Only checked while raceDeadlineOn.
+volatile unsigned long raceDeadlineMillis = 0;
+volatile bool raceDeadlineOn = false;
+// Set by the lane interrupt on a lane's 1 crossing after the deadline, which finishes its current lap, see FINISH_CURRENT_LAP.
+volatile bool lapFinal[laneCount + 1] = {};
+// Set once a Timed race's clock has run out, from then on the leader board is placed by RankTimedFinish().
+bool raceTimeUp = false;
 
 // flag indicating if race state is in preStart countdown or active race
 // volatile bool preStart = false;
@@ -301,6 +866,111 @@ bool raceDataExists = false;
 // Variable to record state of lane seneor pins.
 volatile byte triggeredPins = 0;
 
+// ***** DRAG RACE TIMING *********
+// Drag timing is logged in microseconds, as a timing slip reports it to the 1000th of a second.
+// micros() timestamp of the green light, the reference for all drag lane timing.
+volatile unsigned long dragGreenMicros = 0;
+// micros() timestamp the pre-start countdown is due to turn green, used to size a red light.
+unsigned long dragGreenDueMicros = 0;
+// micros() timestamps of each drag lane's start line, [0], and finish line, [1], crossing.
+// With SINGLE_DRAG_TRIGGER only the finish line is logged.
+volatile unsigned long dragMicros[3][2] = {};
+// For a red light (start fault), how many us before the green the lane left the start.
+volatile unsigned long dragRedLightMicros[3] = {};
+// Results of a drag heat in us; reaction time (RT), elapsed time (ET), and their total.
+// The total, green light to finish line, decides the winner.
+unsigned long dragRT[3] = {};
+unsigned long dragET[3] = {};
+unsigned long dragTotal[3] = {};
+// Total logged for a lane that did not reach the finish line.
+const unsigned long dragDNF = 0xFFFFFFFF;
+
+// ***** SECTOR SPLIT TIMING *********
+// millis() timestamp of each lane's sector sensor crossing, on the lap it was logged on.
+volatile unsigned long sectorMillis[laneCount + 1] = {};
+// lapCount of the lap the sector timestamp was logged on, so only 1 split is taken per lap.
+volatile int sectorLap[laneCount + 1] = {};
+// Set by the ISR to flag a new sector split is waiting to be displayed.
+volatile bool sectorFlash[laneCount + 1] = {};
+// The sector 1 split of each lap in the lastXMillis que, stored at the same que idx as the lap.
+// Sector 2 is the lap time less the sector 1 split. A lap without a split is logged as 0.
+unsigned long lastXSectorMillis[laneCount + 1][lapMillisQSize] = {};
+// Best sector 1, [0], and sector 2, [1], split of each racer, 0 if not yet set.
+unsigned long bestSectorMillis[laneCount + 1][2] = {};
+
+// ***** LIVE GAPS *********
+// Gaps are worked out once per completed lap, from the crossing timestamps, without looking back through the laps.
+// The leader's crossing timestamp of each of its last lapMillisQSize laps, at the same que idx as lastXMillis.
+unsigned long gapLeadMillis[lapMillisQSize] = {};
+// Most laps completed by any lane, and the lane that completed it 1st.
+int gapLeadLaps = 0;
+byte gapLeadLane = 0;
+// Each lane's gap to the leader, and # of laps down, as of its last crossing.
+unsigned long gapMillis[laneCount + 1] = {};
+byte gapLapsDown[laneCount + 1] = {};
+// The live leader board swaps between showing the gap to the leader, and the interval to the car ahead.
+bool gapShowInterval = false;
+unsigned long gapSwapMillis = 0;
+
+// ***** TRIGGER HEALTH DIAGNOSTICS *********
+// The ISR timestamps both edges of each lane sensor pulse, to measure how long a trigger holds the pin LOW.
+// A pulse shorter than the ISR latency is gone before the port is read, which shows up as a zero-read.
+// Lane trigger bits of the last port read, 1 = triggered, used to detect which pins changed.
+volatile byte lastPortPins = 0;
+// micros() timestamp of the leading edge of each lane's current pulse, 0 if no pulse is open.
+volatile unsigned long pulseStartMicros[laneCount + 1] = {};
+// Min, max, and sum of pulse widths in us, and the pulse count, of each lane.
+// Widths are capped at 65535us, so a sensor held LOW doesn't roll the sum over.
+volatile unsigned int pulseMinMicros[laneCount + 1] = {};
+volatile unsigned int pulseMaxMicros[laneCount + 1] = {};
+volatile unsigned long pulseSumMicros[laneCount + 1] = {};
+volatile unsigned int pulseCount[laneCount + 1] = {};
+// Count of interrupts where no lane pin had changed by the time the port was read, for each lane.
+// A zero-read is put down to a lane when its lane or sector pin was the only one able to fire, otherwise to idx 0.
+volatile unsigned int zeroReadCount[laneCount + 1] = {};
+
+// ***** LATENCY HISTOGRAMS *********
+// Log2 bucketed histograms of byte counters, of the ISR execution time,
+// and of the loop() iteration time, kept for each of the 'states'.
+// Bucket 0 holds times under (1 << BASE_SHIFT) us, and each bucket after it doubles the range.
+// The last bucket holds all times past the 2nd last.
+const byte latencyBuckets = 8;
+// ISR buckets start from under 8us, the last is 512us+
+const byte ISR_HIST_BASE_SHIFT = 3;
+// loop() buckets start from under 128us, the last is 8.192ms+
+const byte LOOP_HIST_BASE_SHIFT = 7;
+byte isrLatencyHist[latencyBuckets] = {};
+byte loopLatencyHist[PreFault + 1][latencyBuckets] = {};
+// micros() timestamp at the start of the last loop(), and the state it ran in.
+unsigned long loopStartMicros = 0;
+states loopState = Menu;
+// Names of the 'states', in enum order, for the loop() latency pages.
+const char StateNames[PreFault + 1][9] PROGMEM = {
+  "Menu", "Race", "Paused", "Fault", "PreStart", "Staging", "Finish", "PreFault"
+};
+
+#if BUS_ACCOUNTING && !I2C_ASYNC
+  #pragma message "BUS_ACCOUNTING: I2C isn't counted without I2C_ASYNC, only the LED bus is"
+#endif
+#if BUS_ACCOUNTING
+// ***** BUS ACCOUNTING *********
+// Most of a loop()'s time goes to writing the displays, so the bus traffic of each state is counted,
+// and turned into an estimate of the time it takes on the wire.
+// I2C (LCD & bargraph) is counted by the TWI interrupt, so only with I2C_ASYNC. Without it, the hd44780 and Adafruit
+// libraries write to the Wire library themselves, where their bytes can't be counted, and the I2C figures stay at 0.
+// The MAX7219 LED chain is counted by 'lc', a CountedLedControl.
+// ms spent in each state, and its I2C bytes, I2C transactions, and LED bytes.
+unsigned long busStateMillis[PreFault + 1] = {};
+unsigned long busI2cBytes[PreFault + 1] = {};
+unsigned long busI2cStarts[PreFault + 1] = {};
+unsigned long busLedBytes[PreFault + 1] = {};
+// Estimated us of I2C, and LED, bus time in each state.
+unsigned long busI2cMicros[PreFault + 1] = {};
+unsigned long busLedMicros[PreFault + 1] = {};
+// millis() when the bus traffic was last logged.
+unsigned long busLogMillis = 0;
+#endif
+
 
 // ******* LANE/RACER VARIABLES ******************
 // In all arrays relating to this data the array index will equal the associate lane/racer#.
@@ -311,39 +981,90 @@ volatile byte laneEnableStatus[ laneCount + 1 ] = {};
 // These help keep code easier to read instead of calculating them repeatedly from status array.
 byte enabledLaneCount = 0;
 byte finishedCount = 0;
-// Holds index of Racers[] array that indicates the name of racer associated with lane.
+// Finishing place of each lane, 0 until it's finished, decided by its final crossing timestamp, see FinishLanes().
+// Lanes that crossed at the same timestamp share a place, and are flagged as tied.
+byte finishPlace[ laneCount + 1 ] = {};
+bool finishTie[ laneCount + 1 ] = {};
+// Holds index of the racer names list that indicates the name of racer associated with lane.
 // set racer name to '0' when status is Off.
-// Other than 0, the same Racer[idx] cannot be used for more than 1 racer.
+// Other than 0, the same name idx cannot be used for more than 1 racer.
 // During use, the code will prevent this, but it will not correct duplicates made here.
+// Change it with SetLaneRacer(), which keeps the racerInUse[] bits in step.
 byte laneRacer[ laneCount + 1 ] = {};
 
 // After a racer finishes a lap the logged time will be 'flashed' up
 // to that racer's LED. The period that this lap time stays displayed
 // before the display returns to logging current lap time is the 'flash' period.
-// The lane Lap Flash variables indicate the state of this flash period.
-// 0 = update display with racer's current lap and running time.
-// 1 = process data for last finished lap, and write result to racer's LED.
-// 2 = hold the last finished lap info on display until flash time is up.
+// The lane flash status is set by the lap interrupt, and cleared by the Race timing context once it has logged the lap.
+// 0 = no lap waiting to be processed.
+// 1 = process data for last finished lap, then post it to the UI context, which flashes it to the racer's LED.
 // lap flash status idx corresponds to status of lane #, idx0 reserved.
-// The flash display period does not affect active timing, or any other functions.
 volatile byte flashStatus[ laneCount + 1 ] = {};
 
+// The flash display period does not affect active timing, or any other functions.
 const int flashDisplayTime = DEFAULT_FLASH_PERIOD_LENGTH;
+// true while a lap or sector time is held on the racer's LED, in place of their running lap time.
+bool flashHold[ laneCount + 1 ] = {};
 // logs millis() timestamp at start of current flash period for each racer.
 unsigned long flashStartMillis[ laneCount + 1 ];
 
+// The Race state runs as 2 contexts, that only talk through the race event queue and the race snapshot.
+// The timing context, RaceTimingStep(), takes the crossings logged by the lane interrupts, keeps the race clock,
+// logs the lap data, and checks for the finish. The UI context, RaceUiStep(), draws the LCD and LEDs, and plays the audio.
+// Here they take turns, once each per loop(). Only the timing context posts, and only the UI context takes,
+// so the queue needs no locking, and the UI context only reads the race tables for an event once it's been posted.
+struct RaceEvent {
+  raceEvents type;
+  byte lane;
+  int data;
+  unsigned long time;
+};
+const byte raceEventQSize = 8;
+RaceEvent raceEventQ[raceEventQSize];
+// Idx of where the next event will go, and of the next event to be taken. The queue is empty when they are equal.
+volatile byte raceEventHead = 0;
+volatile byte raceEventTail = 0;
+// Max # of events the UI context handles in a loop(), so a burst of laps can't hold off the timing context.
+const byte raceUiBurst = 3;
+// Set once the timing context has posted EvRaceOver, until the next race.
+bool raceOverPosted = false;
+// Set when a lap has changed the leader board, so the UI context redraws it.
+bool raceLcdDue = false;
+
+// The values the UI context draws from, written by the timing context at the end of each step.
+struct RaceSnapshot {
+  unsigned long nowMillis;
+  // ms since the race started, and the race clock, which counts down in a Timed race.
+  unsigned long elapsed;
+  unsigned long clock;
+  unsigned long laneTime[ laneCount + 1 ];
+  int laps[ laneCount + 1 ];
+  byte status[ laneCount + 1 ];
+};
+RaceSnapshot raceSnap;
+
 // Index of lap time to display in first row of results window.
 // Keep this an int so it can be signed. A negative is the trigger to loop index
 int resultsRowIdx = 0;
 // Tracks which racer's results to show in Results Menu, 0 = show top results overall.
 byte resultsMenuIdx = 0;
+// Results Menu page of the season standings, after the finish leader board and tournament standings.
+const byte resultsSeasonIdx = laneCount + 3;
+// Tracks which page to show in the hidden Diagnostics Menu.
+byte diagMenuIdx = 0;
+// There is a page per lane, 1 for the ISR, 1 per state, 1 for the bus accounting and 1 for the track simulator
+// if they're built in, and 1 for the link to the slave controllers, if this is a linked master.
+const byte diagBusPage = laneCount + PreFault + 2;
+const byte diagSimPage = diagBusPage + (BUS_ACCOUNTING ? 1 : 0);
+const byte diagLinkPage = diagSimPage + (TRACK_SIMULATOR ? 1 : 0);
+const byte diagPageCount = diagLinkPage + (LINK_NODE == 1 ? 1 : 0);
 
 // Variable to hold the last digit displayed to LEDs during last 3 sec
 // of the pre-start countdown, so it does not rewrite every program loop.
 byte ledCountdownTemp = 0;
 
-// flag to trigger when 1st racer crosses finish.
-bool winner = false;
+// Lanes lit on the drag winner lights, a bit for each lane, so they're only redrawn when 1st place changes.
+byte dragWinLights = 0;
 
 // Create variables to hold current game state and menu state.
 volatile states state;
@@ -353,10 +1074,17 @@ Menus currentMenu;
 // that one time only setup can be performed.
 volatile bool entryFlag;
 
+// millis() of the last key or button press, or state change, for the idle power manager.
+unsigned long idleInputMillis = 0;
+
 void ChangeStateTo(volatile states newState){
+  idleInputMillis = millis();
   prevState = state;
   state = newState;
   entryFlag = true;
+  // A button press that wasn't read by the last state is not carried into the new one.
+  buttonEdge[0] = false;
+  buttonEdge[1] = false;
 }
 
 
@@ -373,17 +1101,68 @@ bool gameAudioOn = true;
 bool musicAudioOn = true;
 
 
-// Racer Names list.
-// Because this is an array of different length character arrays
-// we use an array of pointers.
-// The size of 'Racers[]' and 'victorySongs[]' should match if SONGS_BY_PLACE is 'false'.
-// byte const racerListSize = RACER_LIST_SIZE;
-// Keep in mind that the 7-seg racer lap displays, cannot write W's, M's, X's, K's, or V's
-// const char* Racers[racerListSize] = RACER_NAMES_LIST;
-const char* Racers[] = RACER_NAMES_LIST;
-// Racer's victory song, matched by index of racer.
-// const char* victorySong[racerListSize] = RACER_SONGS_LIST;
-const char* victorySong[] = RACER_SONGS_LIST;
+// Racer Names roster.
+// Names are kept in flash at a fixed stride of RACER_NAME_CHARS + 1, so a club sized roster
+// doesn't cost any SRAM. Read a name out with RacerName(idx).
+// Keep in mind that the 7-seg racer lap displays only draw W's, M's, X's, K's, and V's as rough shapes.
+const char racerNames[][RACER_NAME_CHARS + 1] PROGMEM = RACER_NAMES_LIST;
+const byte racerListSize = sizeof(racerNames) / sizeof(racerNames[0]);
+static_assert(sizeof(racerNames) / sizeof(racerNames[0]) <= 255, "RACER_NAMES_LIST holds at most 255 names, including TEXT_OFF");
+// SRAM copy of the last name read by RacerName().
+char racerNameBuf[RACER_NAME_CHARS + 1];
+// One bit per roster name, set while the name is assigned to a lane, so checking that
+// a name is free doesn't need a scan of the lanes. Only updated through SetLaneRacer().
+byte racerInUse[ (sizeof(racerNames) / sizeof(racerNames[0]) + 7) / 8 ] = {};
+// # of roster digits to enter when jumping to a racer by number.
+const byte racerNumDigits = racerListSize > 100 ? 3 : 2;
+// T9 keypad digits typed so far on the Select Racers menu, matched against the start of names.
+char racerPrefix[RACER_NAME_CHARS + 1] = "";
+byte racerPrefixLen = 0;
+// Lane last picked on the Select Racers menu, which typed digits apply to.
+byte racerPrefixLane = 1;
+unsigned long racerPrefixMillis = 0;
+// Keypad digit for each letter, a-z.
+const char t9Keys[] PROGMEM = "22233344455566677778889999";
+// Victory song table, also in flash.
+// If SONGS_BY_PLACE is 'false', a racer plays the song picked by RACER_SONG_IDS,
+// or when that isn't set, the song with the same index as the racer's name.
+#if BUILD_AUDIO
+  const char* const victorySong[] PROGMEM = RACER_SONGS_LIST;
+  const byte victorySongCount = sizeof(victorySong) / sizeof(victorySong[0]);
+#endif
+#if defined ( RACER_SONG_IDS )
+  const byte racerSongIds[] PROGMEM = RACER_SONG_IDS;
+#endif
+
+
+// ******* TOURNAMENT VARIABLES ******************
+// A tournament runs a series of heats back to back from a roster of racers.
+// The next heat's lanes are assigned as soon as the current heat finishes,
+// so the only operator input needed between heats is a start press.
+tourneyModes tourneyMode = NoTourney;
+// # of racers in the roster, taken from the start of the racer names list, skipping the 'Off' label.
+const byte tourneyRosterSize =
+  (TOURNEY_ROSTER_SIZE > 0 && TOURNEY_ROSTER_SIZE < racerListSize) ?
+  TOURNEY_ROSTER_SIZE : racerListSize - 1;
+// Points awarded per finishing place, idx0 is DNF.
+const byte tourneyPlacePoints[5] = TOURNEY_POINTS;
+// Running standings, indexed by the racer's name idx, so idx0 is unused.
+// Only sized for the tournament roster, not the whole names list.
+// Points are added at the end of each heat, never recalculated from earlier heats.
+byte tourneyPoints[ tourneyRosterSize + 1 ] = {};
+// For Elimination mode, flags racers who have been knocked out.
+bool tourneyOut[ tourneyRosterSize + 1 ] = {};
+// # of heats completed in the current tournament.
+byte tourneyHeat = 0;
+// Roster position the next heat's lane assignment starts from.
+byte tourneyCursor = 0;
+// Set when there are no more heats to run.
+bool tourneyOver = false;
+// The operator's lane settings and racers, from before the tournament changed them for its heats.
+// Put back by TourneyRestore() once the tournament has been left.
+byte tourneySavedStatus[ laneCount + 1 ];
+byte tourneySavedRacer[ laneCount + 1 ];
+bool tourneySaved = false;
 
 // sets screen cursor position for the names on the racer select menu
 byte nameEndPos = 19;
@@ -570,14 +1349,41 @@ unsigned long ClockToMillis(const byte ulHour, const byte ulMin, const byte ulSe
 
 
 // tone(pin with buzzer, freq in Hz, duration in ms)
+// Without BUILD_AUDIO they're left empty, and tone() isn't linked in.
 void Beep() {
-  if (gameAudioOn) tone(buzzPin1, BEEP_FREQ, BEEP_DUR);
+  #if BUILD_AUDIO
+    if (gameAudioOn) tone(buzzPin1, BEEP_FREQ, BEEP_DUR);
+  #endif
 }
 void Boop() {
-  if (gameAudioOn) tone(buzzPin1, BOOP_FREQ, BOOP_DUR);
+  #if BUILD_AUDIO
+    if (gameAudioOn) tone(buzzPin1, BOOP_FREQ, BOOP_DUR);
+  #endif
 }
 void Bleep() {
-  if (gameAudioOn) tone(buzzPin1, BLEEP_FREQ, BLEEP_DUR);
+  #if BUILD_AUDIO
+    if (gameAudioOn) tone(buzzPin1, BLEEP_FREQ, BLEEP_DUR);
+  #endif
+}
+
+// Stops any song playing, and plays victorySong[songIdx] if music is on.
+// An idx past the end of the song list wraps around, skipping the 'off' song at idx0.
+#if BUILD_AUDIO
+void PlayVictorySong(byte songIdx) {
+  stopPlayRtttl();
+  if (songIdx >= victorySongCount) songIdx = (songIdx - 1) % (victorySongCount - 1) + 1;
+  if (musicAudioOn) startPlayRtttlPGM(buzzPin1, (const char*)pgm_read_word(&victorySong[songIdx]));
+}
+#else
+void PlayVictorySong(byte /*songIdx*/) {}
+#endif
+
+// Returns the victory song idx of racer name idx, 'racer'.
+byte RacerSong(byte racer) {
+  #if defined ( RACER_SONG_IDS )
+    if (racer < sizeof(racerSongIds)) return pgm_read_byte(&racerSongIds[racer]);
+  #endif
+  return racer;
 }
 
 
@@ -591,9 +1397,19 @@ void InitializeRacerArrays(){
     }
     for (byte j = 0; j < lapMillisQSize; j++) {
       lastXMillis[i][j] = 0;
+      lastXSectorMillis[i][j] = 0;
     }
     racersTotalTime[i] = 0;
+    sectorLap[i] = 0;
+    sectorFlash[i] = false;
+    bestSectorMillis[i][0] = 0;
+    bestSectorMillis[i][1] = 0;
+    gapMillis[i] = 0;
+    gapLapsDown[i] = 0;
   }
+  memset(gapLeadMillis, 0, sizeof(gapLeadMillis));
+  gapLeadLaps = 0;
+  gapLeadLane = 0;
   // for (byte i = 0; i <= laneCount; i++) {
   //   for (byte j = 0; j < lapMillisQSize; j++) {
   //     lastXMillis[i][j] = 0;
@@ -632,26 +1448,97 @@ void UpdateLCDMenu(const char *curMenu[]){
 }
 
 
+// Copies racer name 'idx' out of flash and returns it.
+// The copy is overwritten by the next call, so print it before reading another name.
+const char* RacerName(byte idx) {
+  strcpy_P(racerNameBuf, racerNames[idx]);
+  return racerNameBuf;
+}
+
+bool RacerInUse(byte idx) {
+  return racerInUse[idx >> 3] & (1 << (idx & 7));
+}
+
+// Assigns racer name idx, 'racer', to lane 'laneID', and updates which names are in use.
+// The old name is only released if no other lane still holds it, which can
+// happen for a moment while a tournament heat reassigns all the lanes.
+void SetLaneRacer(byte laneID, byte racer) {
+  byte old = laneRacer[laneID];
+  laneRacer[laneID] = racer;
+  if (old != 0) {
+    bool held = false;
+    for (byte i = 1; i <= laneCount; i++){
+      if (laneRacer[i] == old) held = true;
+    }
+    if (!held) racerInUse[old >> 3] &= ~(1 << (old & 7));
+  }
+  if (racer != 0) racerInUse[racer >> 3] |= (1 << (racer & 7));
+}
+
 // This function provides cycling of racer name selection without,
 // allowing two racer's to choose the same name.
 // laneID is the laneNumber whose racer name should be indexed.
 // The value in laneRacer[laneID] is the index of the racer name array.
+// While a T9 prefix typed for this lane is live, only names matching it are cycled through.
+// Returns the current name if there isn't another free one.
 byte IndexRacer(byte laneID) {
   byte newRacerNameIndex = laneRacer[laneID];
-  bool notUnique = true;
-  // The modulus (%) of a numerator smaller than its denominator is equal to itself,
-  // while the modulus of an integer with itself is 0. Add 1 to restart at idx 1, not 0.
-  byte racerListSize = (sizeof(Racers)/sizeof(char*));
-  while(notUnique){
-    newRacerNameIndex = ((newRacerNameIndex + 1)%racerListSize == 0) ? 1 : (newRacerNameIndex + 1)%racerListSize;
-    notUnique = false;
-    for(byte i = 1; i <= laneCount; i++){
-      if((i != laneID) && (laneRacer[i] == newRacerNameIndex)){
-        notUnique = true;
-      }
+  bool usePrefix = (racerPrefixLen > 0 && racerPrefixLane == laneID && millis() - racerPrefixMillis <= RACER_T9_TIMEOUT);
+  if (usePrefix) racerPrefixMillis = millis();
+  // The zero index is reserved for the disabled lane label, so wrap back to 1 not 0.
+  for (byte n = 1; n < racerListSize; n++){
+    newRacerNameIndex = (newRacerNameIndex + 1 >= racerListSize) ? 1 : newRacerNameIndex + 1;
+    if (!RacerInUse(newRacerNameIndex) && (!usePrefix || RacerMatchesPrefix(newRacerNameIndex))) {
+      return newRacerNameIndex;
+    }
+  }
+  return laneRacer[laneID];
+}
+
+// Shows a lane's newly picked racer name on the LCD Select Racers row and the lane's LED,
+// then plays a sample of the racer's victory song.
+void ShowPickedRacer(byte laneNumber) {
+  PrintText(RacerName(laneRacer[laneNumber]), lcdDisp, nameEndPos, 11, false, laneNumber-1, true);
+  PrintText(RacerName(laneRacer[laneNumber]), displays(laneNumber), 7, 8, false, 0, true);
+  if (!SONGS_BY_PLACE) PlayVictorySong(RacerSong(laneRacer[laneNumber]));
+}
+
+// Returns the keypad digit a character is typed with on a T9 phone keypad.
+// Digits are themselves, spaces are '0', and any other symbol is '1'.
+char T9Key(char c) {
+  if (c >= '0' && c <= '9') return c;
+  if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+  if (c >= 'a' && c <= 'z') return pgm_read_byte(&t9Keys[c - 'a']);
+  return (c == ' ') ? '0' : '1';
+}
+
+// True if the start of racer name 'idx' is typed with the keys in racerPrefix[].
+bool RacerMatchesPrefix(byte idx) {
+  for (byte i = 0; i < racerPrefixLen; i++){
+    char c = pgm_read_byte(&racerNames[idx][i]);
+    if (c == '\0' || T9Key(c) != racerPrefix[i]) return false;
+  }
+  return true;
+}
+
+// Adds keypad digit 'key' to the T9 prefix being typed for lane 'laneID',
+// then jumps the lane to the first free name matching it.
+// The prefix starts over after a pause of RACER_T9_TIMEOUT, or on a different lane.
+// Returns false, and leaves the prefix as it was, if no free name matches.
+bool TypeRacerPrefix(byte laneID, char key) {
+  if (racerPrefixLane != laneID || millis() - racerPrefixMillis > RACER_T9_TIMEOUT) racerPrefixLen = 0;
+  if (racerPrefixLen >= RACER_NAME_CHARS) return false;
+  racerPrefixLane = laneID;
+  racerPrefix[racerPrefixLen++] = key;
+  for (byte idx = 1; idx < racerListSize; idx++){
+    if ((idx == laneRacer[laneID] || !RacerInUse(idx)) && RacerMatchesPrefix(idx)) {
+      racerPrefixMillis = millis();
+      SetLaneRacer(laneID, idx);
+      return true;
     }
   }
-  return newRacerNameIndex;
+  racerPrefixLen--;
+  return false;
 }
 
 
@@ -693,30 +1580,18 @@ byte IndexRacer(byte laneID) {
 // }
 
 
+// The Print functions below only pick the display's driver. The formatting is done in 'DisplayDrivers.h',
+// with a copy built for each driver, so it's never switched on the display type as it writes.
+
 // Used to write same character repeatedly from start to end position, inclusive.
 // This is primarily used to clear lines and space before writing an update to display.
 void PrintSpanOfChars(displays disp, byte lineNumber = 0, int posStart = 0, int posEnd = LCD_COLS - 1, char printChar = ' ') {
-  switch(disp){
-    case lcdDisp:{
-      // Serial.println(printChar);
-      // Serial.print("StartPos: ");
-      // Serial.println(posStart);
-      // Serial.print("EndPos: ");
-      // Serial.println(posEnd);
-      lcd.setCursor(posStart, lineNumber);
-      for(int n = posStart; n <= posEnd; n++){
-        lcd.print(printChar);
-      }
-    }
-    break;
-    // Assumes that Racer LED bars are the only other display.
-    default: {
-      for(int i = posStart; i <= posEnd; i++){
-        lc.setChar(disp-1, (LED_DIGITS - 1) - i, printChar, false);
-      }
-    }
-    break;
-  }
+  if (disp == lcdDisp) PrintSpanOn<MainDisplay>(0, lineNumber, posStart, posEnd, printChar);
+  #if DISPLAY_COPROC == 1
+    else CoprocSpan(disp - 1, posStart, posEnd, printChar);
+  #else
+    else PrintSpanOn<LaneDisplay>(disp - 1, lineNumber, posStart, posEnd, printChar);
+  #endif
 }
 
 
@@ -739,101 +1614,23 @@ void ledWriteDigits(byte digit) {
 // NOTES:  this function doesn't error check, if the number is larger than the width
 // the digits outside of the width (the largest place digits) will not be printed.
 void PrintNumbers(const unsigned long numberIN, const byte width, const byte endPosIdx, displays display, bool leadingZs = true, const byte line = 0, bool endWithDecimal = false){
-  // we take 1 away from width because the endposition is inclusive in the width count
-  byte cursorStartPos = endPosIdx - (width - 1);
-  byte cursorEndPos = endPosIdx;
-  byte digitValue;
-  // variable to track present digit by its place value
-  byte placeValue = width - 1;
-  switch (display) {
-    // for printing to the main LCD
-    case lcdDisp: {
-      // written to screen from max place value to min defined by width and end position
-      for (byte displayIdx = cursorStartPos; displayIdx <= cursorEndPos; displayIdx++) {
-        lcd.setCursor(displayIdx, line);
-        // print current place value's digit
-        digitValue = numberIN / ipow(10, placeValue) % 10;
-        if (!leadingZs && digitValue == 0){
-          lcd.print(" ");
-        }
-        else {
-          lcd.print(digitValue);
-          // once we get non-zero digit then we want all zeros
-          leadingZs = true; 
-        }
-        placeValue--;
-      }
-      if (endWithDecimal) lcd.print(".");
-    }
-    break;
-    // for printing to LED bar displays
-    default:{
-      for (byte displayIdx = cursorStartPos; displayIdx <= cursorEndPos; displayIdx++) {
-        // print current place value's digit
-        digitValue = numberIN / ipow(10, placeValue) % 10;
-        if(!leadingZs && digitValue == 0){
-          // skip this digit
-        }
-        else {
-          lc.setDigit(
-            display - 1, 
-            (LED_DIGITS - 1) - displayIdx, 
-            digitValue,
-            endWithDecimal && displayIdx == cursorEndPos);
-            // once we get non-zero digit then we want all zeros
-            leadingZs = true;
-        }
-        placeValue--;
-      }
-    }
-    break;
-  }
+  if (display == lcdDisp) PrintNumbersOn<MainDisplay>(0, numberIN, width, endPosIdx, leadingZs, line, endWithDecimal);
+  #if DISPLAY_COPROC == 1
+    else CoprocNumber(display - 1, numberIN, width, endPosIdx, leadingZs, endWithDecimal);
+  #else
+    else PrintNumbersOn<LaneDisplay>(display - 1, numberIN, width, endPosIdx, leadingZs, line, endWithDecimal);
+  #endif
 }
 
 
 // This function prints the input text, to the indicated display, at the indicated position.
 void PrintText(const char textToWrite[LCD_COLS], const displays display, const byte writeSpaceEndPos, const byte width = LED_DIGITS, bool rightJust = false, const byte line = 0, bool clear = true) {
-  // Even if text is right justified, available space is filled starting with 1st character.
-  // Need to track the character index seperately from display digit position.
-  byte const textLength = strlen(textToWrite);
-  // We take 1 away from width because the endposition is inclusive in the width count.
-  byte cursorStartPos = writeSpaceEndPos - (width - 1);
-  byte cursorEndPos = writeSpaceEndPos;
-  // Adjust start and end positions based on text length and available space.
-  if (textLength < width && rightJust) cursorStartPos = cursorEndPos - (textLength - 1);
-  if (textLength < width && !rightJust) cursorEndPos = cursorEndPos - (width - textLength);
-  // Because the writing position index may not match the text char index
-  // we nust track them seperately.
-  byte textIndex = 0;
-  switch (display) {
-    // For writing to LCD display
-    case lcdDisp: {
-      // For clearing we want to clear the whole space so we don't use adjusted positions.
-      if (clear) PrintSpanOfChars(display, line, (writeSpaceEndPos-width+1), writeSpaceEndPos);
-      for (byte i = cursorStartPos; i <= cursorEndPos; i++){
-        lcd.setCursor(i, line);
-        lcd.print(textToWrite[textIndex]);
-        textIndex++;
-      }
-    } // END LCD case
-    break;
-    // For writing to LED display
-    // Note that 7-seg cannot display 'K', 'W', 'M', 'X's, 'W'x, or 'V's
-    default:{
-      // If 'clear' = true then clear the original width from the end position -1.
-      if (clear) PrintSpanOfChars(display, line, (writeSpaceEndPos-width+1), writeSpaceEndPos);
-      // Serial.print("Print TExt - writeSpacedEnd Pos:  ");
-      // Serial.println(writeSpaceEndPos);
-      // Serial.print("beginning position:  ");
-      // Serial.println(writeSpaceEndPos-width+1);
-      for (byte j = cursorStartPos; j <= cursorEndPos; j++){
-        // The digit position of the LED bars is right to left so flip the requested index.
-        lc.setChar(display - 1, (LED_DIGITS-1) - j, textToWrite[textIndex], false);
-        textIndex++;
-      }
-    } // END LED cases
-    break;
-  } // END display switch
+  if (display == lcdDisp) PrintTextOn<MainDisplay>(0, textToWrite, writeSpaceEndPos, width, rightJust, line, clear);
+  #if DISPLAY_COPROC == 1
+    else CoprocText(display - 1, textToWrite, writeSpaceEndPos, width, rightJust, clear);
+  #else
+    else PrintTextOn<LaneDisplay>(display - 1, textToWrite, writeSpaceEndPos, width, rightJust, line, clear);
+  #endif
 }
 
 
@@ -863,181 +1660,13 @@ void PrintText(const char textToWrite[LCD_COLS], const displays display, const b
 // and an 'E' will be written to notify view width has been exceeded.
 // NOTE: An 'E' does not affect that actual timing which can go on for about 49 days.
 void PrintClock(ulong timeMillis, byte clockEndPos, byte printWidth, byte precision, displays display, byte line = 0, bool leadingZs = false) {
-
-  clockWidth nextTimeBlock = H;
-  int maxPrecision = 0;
-  byte baseTimeWidth = 0;
-
-  // Based on the time value, and width of display area (printWidth),
-  // calculate how many decimal places can be accomodated.
-  // Because the LCD requires a character space for ':' and '.',
-  // we must adjust the required width accordingly.
-  // 'baseTimeWidth' is min width needed for the whole units HH:MM:SS and colons.
-  //
-  // if t < 10sec
-  // 0.0
-  if(timeMillis < 10000){
-    nextTimeBlock = S;
-    maxPrecision = (display == lcdDisp ? printWidth-2 : printWidth-1);
-    baseTimeWidth = 1;
-  } else
-  // if 10sec <= t < 1min
-  // 00
-  if (timeMillis < 60000){
-    nextTimeBlock = S;
-    maxPrecision = (display == lcdDisp ? printWidth-3 : printWidth-2);
-    baseTimeWidth = 2;
-  } else
-  // if 1min <= t < 10min
-  // 0:00
-  if (timeMillis < 600000){
-    nextTimeBlock = M;
-    maxPrecision = (display == lcdDisp ? printWidth-5 : printWidth-3);
-    baseTimeWidth = (display == lcdDisp ? 4 : 3);
-  } else
-  // if 10min <= t < 1hr
-  // 00:00
-  if (timeMillis < 3600000){
-    nextTimeBlock = M;
-    maxPrecision = (display == lcdDisp ? printWidth-6 : printWidth-4);
-    baseTimeWidth = (display == lcdDisp ? 5 : 4);
-  } else
-  // if 1hr <= t < 10hr
-  // 0:00:00
-  if (timeMillis < 30600000){
-    nextTimeBlock = H;
-    maxPrecision = (display == lcdDisp ? printWidth-8 : printWidth-5);
-    baseTimeWidth = (display == lcdDisp ? 7 : 5);
-  } else
-  // if 10hr <= t < 24hr
-  // 00:00:00
-  if (timeMillis < 86,400,000){
-    nextTimeBlock = H;
-    maxPrecision = (display == lcdDisp ? printWidth-9 : printWidth-6);
-    baseTimeWidth = (display == lcdDisp ? 8 : 6);
-  } else {
-  // if 24hr <= t
-  // over max clock limit of 24 hrs.
-  if (timeMillis >= 86,400,000)
-    maxPrecision = -1;
-  }
-
-  // A negative maxPrecision means we don't have space to print the time.
-  if (maxPrecision < 0){
-    // Print an 'E' to alert current time is over display width limit.
-    PrintText("E", display, clockEndPos, printWidth, true, line, display == lcdDisp ? true : false);
-
-  } else {
-    unsigned long ulHour;
-    unsigned long ulMin;
-    unsigned long ulSec;
-    unsigned long ulDec;
-    unsigned long ulCent;
-    unsigned long ulMill;
-    // Convert millisecond time into its individual time blocks.
-    SplitTime(timeMillis, ulHour, ulMin, ulSec, ulDec, ulCent, ulMill);
-    unsigned long decimalSec;
-    byte hourEndPos;
-
-    // if requested precision is higher than available max, use max.
-    precision = maxPrecision < precision ? maxPrecision : precision;
-    // LCD must add character space for colons and decimal place if it has precision.
-    hourEndPos = (display == lcdDisp ?
-                  clockEndPos - (6 + precision + (precision > 0 ? 1 : 0)) :
-                  clockEndPos - (4 + precision)
-                  );
-
-    // If leading zeros are requested but there is no space turn them off.
-    // If LCD, with precision, subtract additional 1 for the decimal position.
-    if( (printWidth - precision - baseTimeWidth - ((display==lcdDisp && precision>0)?1:0)) <= 0 ){
-      leadingZs = false;
-    }
-
-    // calculate total width needed to print time string
-    // Must account for end position being included in the printWidth total.
-    byte totalWidth = baseTimeWidth + (display == lcdDisp ? precision+1: precision);
-    // Clear spaces in print width that occur before clock time's first display digit
-    PrintSpanOfChars(display, line, clockEndPos - printWidth +1, clockEndPos - totalWidth);
-
-    // Set which precision time block to use based on available precision. 
-    switch(precision){
-      case 1:
-        decimalSec = ulDec;
-      break;
-      case 2:
-        decimalSec = ulCent;
-      break;
-      case 3:
-        decimalSec = ulMill;
-      break;
-      default:
-        decimalSec = NULL;
-      break;
-    }
-
-    if (nextTimeBlock == H) {
-      // H 00:00:00
-      switch (display){
-        case lcdDisp: {
-          PrintNumbers(ulHour, 2, hourEndPos, display, leadingZs, line);
-          lcd.print(":");
-        }
-        break;
-        default:{
-          PrintNumbers(ulHour, 2, hourEndPos, display, leadingZs, 0, true);
-        }
-        break;
-      } // END of display switch
-      // All non-leading parts of the clock time should have leading zeros
-      leadingZs = true;
-      // Move on to print Minutes.
-      nextTimeBlock = M;
-    }
-
-    if (nextTimeBlock == M) {
-      // M 00:00
-      switch (display){
-        case lcdDisp: {
-          PrintNumbers(ulMin, 2, hourEndPos + 3, display, leadingZs, line);
-          lcd.print(":");
-        }
-        break;
-        default:{
-          PrintNumbers(ulMin, 2, hourEndPos + 2, display, leadingZs, 0, true);
-        }
-        break;
-      } // END of display switch
-      // All non-leading parts of the clock time should have leading zeros
-      leadingZs = true;
-      // Move on to print seconds
-      nextTimeBlock = S;
-    }
-
-    if (nextTimeBlock == S) {
-      byte pwidth = 2;
-      // if the input time is under 1sec then use only 1 digit width leading zero
-      if (timeMillis < 1000) {
-        leadingZs = true;
-        pwidth = 1;
-      }
-      // S 00.(000)
-      switch (display){
-        case lcdDisp: {
-          PrintNumbers(ulSec, pwidth, hourEndPos + 6, display, leadingZs, line, precision > 0);
-          if(precision > 0) PrintNumbers(decimalSec, precision, clockEndPos, display, true, line);
-        }
-        break;
-        default:{
-          PrintNumbers(ulSec, pwidth, hourEndPos + 4, display, leadingZs, 0, precision > 0);
-          if(precision > 0) PrintNumbers(decimalSec, precision, clockEndPos, display);
-        }
-        break;
-      } // END of display switch
-    } // END of if 'S'
-
-  } // END if 'X' Else
-
-} // END PrintClock()
+  if (display == lcdDisp) PrintClockOn<MainDisplay>(0, timeMillis, clockEndPos, printWidth, precision, line, leadingZs);
+  #if DISPLAY_COPROC == 1
+    else CoprocClock(display - 1, timeMillis, clockEndPos, printWidth, precision, leadingZs);
+  #else
+    else PrintClockOn<LaneDisplay>(display - 1, timeMillis, clockEndPos, printWidth, precision, line, leadingZs);
+  #endif
+}
 
 
 void PreStartDisplaysUpdate(){
@@ -1054,7 +1683,7 @@ void PreStartDisplaysUpdate(){
       // For active lanes, write racer's name to their corresponding lane LED.
       // If pre-start time is less than 3 seconds, this will be immediately written over.
       for(byte i = 1; i <= laneCount; i++){
-        if(laneEnableStatus[i] > 0) PrintText(Racers[laneRacer[i]], displays(i), 7, 8, false);
+        if(laneEnableStatus[i] > 0) PrintText(RacerName(laneRacer[i]), displays(i), 7, 8, false);
       }
     }
     break;
@@ -1070,7 +1699,7 @@ void ToggleLaneEnable(byte laneNumber){
   const bool wasSet = laneEnableStatus[laneNumber] > 0;
   if(laneNumber == 0){
     for (byte i = 1; i <= laneCount; i++){
-      laneRacer[i] = 0;
+      SetLaneRacer(i, 0);
       laneEnableStatus[i] = Off;
     }
     enabledLaneCount = 0;
@@ -1079,12 +1708,12 @@ void ToggleLaneEnable(byte laneNumber){
     if (laneNumber <= laneCount) {
       if(wasSet){
         // If lane had been on then, it's off now and the racer name idx is set to 0.
-        laneRacer[laneNumber] = 0;
+        SetLaneRacer(laneNumber, 0);
         laneEnableStatus[laneNumber] = Off;
         enabledLaneCount--;
       } else {
         // otherwise it was off, and is now on and must get an initial, unused, racer name.
-        laneRacer[laneNumber] = IndexRacer(laneNumber);
+        SetLaneRacer(laneNumber, IndexRacer(laneNumber));
         laneEnableStatus[laneNumber] = StandBy;
         enabledLaneCount++;
       }
@@ -1107,13 +1736,17 @@ void EnablePinInterrupts(bool Enable){
     if(laneEnableStatus[i] > 0 && Enable) {
       // If lane has finished then we don't want to turn it back on.
       // if(laneEnableStatus[i] != 3) pciSetup(laneSensorPin[i]);
-      if(laneEnableStatus[i] != 3) pciSetup(lanes[i][0]);
+      if(laneEnableStatus[i] != 3) {
+        pciSetup(lanes[i][0]);
+        if (laneSectors[i][0] != 255) pciSetup(laneSectors[i][0]);
+      }
       // Serial.println("pin enabled");
     }
     // TURN OFF PIN
     else if(laneEnableStatus[i] > 0 && !Enable){
       // clearPCI(laneSensorPin[i]);
       clearPCI(lanes[i][0]);
+      if (laneSectors[i][0] != 255) clearPCI(laneSectors[i][0]);
       // Serial.println("pin disabled");
     }
   }
@@ -1141,13 +1774,16 @@ void EnablePinInterrupts(bool Enable){
 // read the state of an entire block of pins simultaneously.
 // As long as the sensor positive trigger duration is longer than the
 // exectuion of the ISR(), this controller should never miss a trigger.
+// The measured pulse widths, and zero-reads, can be checked in the Diagnostics Menu.
 //
 // This function enables the port register change interrupt on the given pin.
 void pciSetup(byte pin) {
   // Enable interrupts on pin
   *digitalPinToPCMSK(pin) |= bit (digitalPinToPCMSKbit(pin));
   // Clear any outstanding interrupt
-  PCIFR  |= bit (digitalPinToPCICRbit(pin));
+  // PCIFR flags are cleared by writing a 1, so it is written, not OR'd,
+  // to avoid clearing a flag pending on another port, ie. the keypad.
+  PCIFR  = bit (digitalPinToPCICRbit(pin));
   // Enables the port for interrupts interrupt for the group
   PCICR  |= bit (digitalPinToPCICRbit(pin));
   // Serial.println("setPCI");
@@ -1157,8 +1793,8 @@ void pciSetup(byte pin) {
 
 // This function will disable the port register interrupt on a given pin.
 void clearPCI(byte pin) {
-  // Clear any outstanding interrupt
-  PCIFR  |= bit (digitalPinToPCICRbit(pin));
+  // Clear any outstanding interrupt, without clearing those of other ports.
+  PCIFR  = bit (digitalPinToPCICRbit(pin));
   // Disable interrupts on pin,
   // using a logical AND (&) with the bitwise NOT (~) of the bitmask for the pin
   *digitalPinToPCMSK(pin) &= ~bit (digitalPinToPCMSKbit(pin));
@@ -1170,41 +1806,126 @@ void clearPCI(byte pin) {
 }
 
 
+// ******* KEYPAD DRIVER ******************
+// Returns the next key pressed on the keypad, or NO_KEY if there are none waiting.
+// All keypad reads go through here.
+char GetKey(){
+  #if KEYPAD_INTERRUPTS
+    if (keyQHead == keyQTail) return NO_KEY;
+    char key = keyQ[keyQTail];
+    keyQTail = (keyQTail + 1) % keyQSize;
+    idleInputMillis = millis();
+    return key;
+  #else
+    char key = keypad.getKey();
+    if (key != NO_KEY) idleInputMillis = millis();
+    return key;
+  #endif
+}
+
+#if KEYPAD_INTERRUPTS
+// While idle, all keypad rows are driven LOW and the columns are pulled up.
+// Pressing a key pulls its column LOW, firing the PCINT0 pin change interrupt,
+// so the keypad is only scanned when a key goes down or up.
+// The column pins must all be on port B, pins 8-13, as they are by default on a Nano.
+void KeypadSetup(){
+  for (byte r = 0; r < KP_ROWS; r++){
+    keyRowPort[r] = portOutputRegister(digitalPinToPort(pin_rows[r]));
+    keyRowMask[r] = digitalPinToBitMask(pin_rows[r]);
+    pinMode(pin_rows[r], OUTPUT);
+    digitalWrite(pin_rows[r], LOW);
+  }
+  for (byte c = 0; c < KP_COLS; c++){
+    keyColPin[c] = portInputRegister(digitalPinToPort(pin_column[c]));
+    keyColMask[c] = digitalPinToBitMask(pin_column[c]);
+    pinMode(pin_column[c], INPUT_PULLUP);
+    pciSetup(pin_column[c]);
+  }
+}
+
+// Returns the key held down, or NO_KEY, by driving one row LOW at a time and reading the columns.
+// Leaves all rows driven LOW.
+char ScanKeypad(){
+  char found = NO_KEY;
+  for (byte r = 0; r < KP_ROWS; r++){
+    for (byte i = 0; i < KP_ROWS; i++) *keyRowPort[i] |= keyRowMask[i];
+    *keyRowPort[r] &= ~keyRowMask[r];
+    // Give the column pull-ups time to settle before reading.
+    delayMicroseconds(5);
+    for (byte c = 0; c < KP_COLS; c++){
+      if (!(*keyColPin[c] & keyColMask[c])) found = keys[r][c];
+    }
+  }
+  for (byte i = 0; i < KP_ROWS; i++) *keyRowPort[i] &= ~keyRowMask[i];
+  return found;
+}
+
+// Keypad column pin change interrupt.
+// Interrupts are turned back on while scanning, so lap triggers are not held up by the keypad.
+// The column interrupts are masked during the scan, as the scan itself changes the column pins.
+ISR (PCINT0_vect) {
+  byte colMask = PCMSK0;
+  PCMSK0 = 0;
+  interrupts();
+  char key = ScanKeypad();
+  unsigned long now = millis();
+  if (key == NO_KEY) {
+    if (keyHeld != NO_KEY) keyReleaseMillis = now;
+  } else if (key != keyHeld && (now - keyReleaseMillis) > keyDebounceTime) {
+    // Queue the new key, dropping it if the queue is full.
+    byte next = (keyQHead + 1) % keyQSize;
+    if (next != keyQTail) {
+      keyQ[keyQHead] = key;
+      keyQHead = next;
+    }
+  }
+  keyHeld = key;
+  noInterrupts();
+  // Drop the edges caused by the scan, then re-read the columns in case a key was let go during it.
+  PCIFR = bit(PCIF0);
+  PCMSK0 = colMask;
+  if (keyHeld != NO_KEY) {
+    bool anyLow = false;
+    for (byte c = 0; c < KP_COLS; c++){
+      if (!(*keyColPin[c] & keyColMask[c])) anyLow = true;
+    }
+    if (!anyLow) {
+      keyHeld = NO_KEY;
+      keyReleaseMillis = now;
+    }
+  }
+}
+#endif
+
+
 // dec 15 = binary 1111, default with 4 active lanes
 // as lanes are enabled/disabled, the triggerClearMask should be updated accordingly.
 byte triggerClearMask = 15;
+// Mask of all the sector sensor bits on the interrupt port, set from laneSectors[].
+byte sectorMask = 0;
 
 void setTriggerMask () {
   // triggerClearMask = ipow(2, laneCount)-1;
   for (byte i=1; i <= laneCount; i++){
     // if lane is not 'Off', then it is enabled; add its digit to the mask.
-    if (laneEnableStatus[i] != Off) {
+    // Lanes timed by a linked slave are left out, their pins on this controller aren't used.
+    if (laneEnableStatus[i] != Off && !(LINK_NODE == 1 && (LINK_REMOTE_LANES & (1 << (i-1))))) {
       // byteDigit = 1 << (i-1);
       triggerClearMask = triggerClearMask | (1 << (i-1));
     }
+    // Sector sensors are always in the mask, their lane status is checked in the ISR.
+    sectorMask = sectorMask | laneSectors[i][1];
   }
+  triggerClearMask = triggerClearMask | sectorMask;
 }
 
 // volatile bool test = false;
 volatile byte lastTriggeredPins = 0;
 
-// MICROTIMING code 
-// const byte timeTestSize = 20;
-// volatile long timeTest[timeTestSize];
-// volatile int timeTestCount = 0;
-
-// ISR is a special Arduino Macro or routine that handles interrupts ISR(vector, attributes)
-// PCINT1_vect handles pin change interrupt for the pin block A0-A5, represented in bit0-bit5
-// The execution time of this function should be as fast as possible as
-// interrupts are disabled while inside it.
-// This function takes approximately 0.004 - 0.180ms
-// Use vector 'PCINT1_vect' for ATmega328 based Arduino (ie Nano)
-// Use vector 'PCINT2_vect' for ATmega2560 based Arduino
-// 'PCINT_VECT' is defined in '...Settings.h' files
-ISR (PCINT_VECT) {
-  // MICROTIMING code used for assessing the ISR execution time.
-  // unsigned long logMicros = micros();
-
+// Processes the lane trigger port on a pin change interrupt.
+// It is only called from the ISR(), and runs with interrupts disabled.
+// logMicros is the micros() timestamp taken on entry to the ISR().
+void ReadLaneTriggers(unsigned long logMicros) {
   // This code expects the lap sensors are setup as inputs.
   // This means the pins have been set to HIGH, indicated by a 1 on its register bit.
   // When a button is pressed, or sensor triggered, it should bring the pin LOW.
@@ -1234,38 +1955,122 @@ ISR (PCINT_VECT) {
   // byte triggeredPins = ((INTERRUPT_PORT xor 0b11111111) & 0b00001111);
   // byte triggeredPins = ((INTERRUPT_PORT xor 0b11111111) & triggerClearMask);
   triggeredPins = (~INTERRUPT_PORT & triggerClearMask);
+
+  // Log the edges of each lane's sensor pulse for trigger health diagnostics.
+  // A leading edge is a pin that has gone LOW since the last read, a trailing edge one that's gone HIGH.
+  byte changedPins = triggeredPins ^ lastPortPins;
+  lastPortPins = triggeredPins;
+  if (changedPins == 0) {
+    // The pin that fired the interrupt was back to its old state before it could be read.
+    // Only a pin with its interrupt on, and not held LOW, can have pulsed. The PCMSK bits match the port's bits.
+    byte idlePins = *digitalPinToPCMSK(lanes[1][0]) & triggerClearMask & ~triggeredPins;
+    byte zeroLane = 0;
+    for (byte i = 1; i <= laneCount; i++){
+      if (idlePins != 0 && (idlePins == lanes[i][1] || idlePins == laneSectors[i][1])) zeroLane = i;
+    }
+    if (zeroReadCount[zeroLane] < 0xFFFF) zeroReadCount[zeroLane]++;
+  } else {
+    for (byte i = 1; i <= laneCount; i++){
+      if (!(changedPins & lanes[i][1])) continue;
+      if (triggeredPins & lanes[i][1]) {
+        pulseStartMicros[i] = logMicros;
+        #if TRACK_SIMULATOR
+          SimLogLatency(i, logMicros);
+        #endif
+      } else if (pulseStartMicros[i] != 0) {
+        unsigned long width = logMicros - pulseStartMicros[i];
+        unsigned int capped = (width > 0xFFFF ? 0xFFFF : width);
+        if (pulseCount[i] == 0 || capped < pulseMinMicros[i]) pulseMinMicros[i] = capped;
+        if (capped > pulseMaxMicros[i]) pulseMaxMicros[i] = capped;
+        pulseSumMicros[i] += capped;
+        if (pulseCount[i] < 0xFFFF) pulseCount[i]++;
+        pulseStartMicros[i] = 0;
+      }
+    }
+  }
+
+  // A linked slave doesn't run a race, it only queues the leading edge of each lane trigger for the master.
+  #if LINK_NODE > 1
+    for (byte i = 1; i <= laneCount; i++){
+      if (changedPins & triggeredPins & lanes[i][1]) LinkQueueEvent(i + LINK_FIRST_LANE - 1, logMicros);
+    }
+    return;
+  #endif
+
   // If the voltage drop, on close of a lap trigger switch, is too slight to cause pin to enter LOW state,
   // or controller operation is too slow, the triggering switch may not still be in a LOW state.
   // If this is the case then we just want to ignore the event as we won't know how to attribute it.
-  if (triggeredPins == 0) return;
+  // Lane triggers are only enabled in the menus to test sensors, so they are never counted as laps.
+  if (triggeredPins == 0 || state == Menu) return;
   
   // Note that millis() does not execute inside the ISR().
   // It can be called, and used as the time of entry, but it does not continue to increment.
   unsigned long logMillis = millis();
 
+  // Sector sensor bits are split off before the lane triggers are processed.
+  // A sector crossing is only timestamped here, its split is worked out in the main loop.
+  // Only 1 sector split is taken per lap, and not within the debounce time of the lap start.
+  byte sectorPins = triggeredPins & sectorMask;
+  if (sectorPins) {
+    triggeredPins = triggeredPins & ~sectorMask;
+    if (state == Race && !DragRace()) {
+      for (byte i = 1; i <= laneCount; i++){
+        if ((sectorPins & laneSectors[i][1]) && laneEnableStatus[i] == Active &&
+            sectorLap[i] != lapCount[i] && (logMillis - startMillis[i]) > debounceTime) {
+          sectorMillis[i] = logMillis;
+          sectorLap[i] = lapCount[i];
+          sectorFlash[i] = true;
+        }
+      }
+    }
+    if (triggeredPins == 0) return;
+  }
+
+  ProcessLaneTriggers(triggeredPins, logMillis, logMicros);
+} // END of ReadLaneTriggers()
+
+// Declares a start fault for the lane triggers in 'lanePins', crossed before the green.
+// Called with interrupts off, see ProcessLaneTriggers().
+void StartFault(byte lanePins, unsigned long logMillis, unsigned long logMicros) {
+  // We need to debounce the fault trigger, like a regular trigger.
+  // Store fault trigger timestamp in the 1st element, ie the zero index, of the lastXMillis[] array.
+  if( ( logMillis - lastXMillis [0][0] ) > debounceTime ) {
+    // prevState = state;
+    state = PreFault;
+    // state = Fault;
+    lastTriggeredPins = lanePins;
+    lastXMillis [0][0] = logMillis;
+    // For a drag, log how far ahead of the green each faulting lane left.
+    if (DragRace()) {
+      for (byte i = 1; i <= 2; i++){
+        if (lanePins & lanes[i][1]) dragRedLightMicros[i] = dragGreenDueMicros - logMicros;
+      }
+    }
+  }
+}
+
+// Processes the lane triggers in 'lanePins', which has the lanes[i][1] bit set for each triggered lane.
+// Called from the lane ISR, and for a linked master, with interrupts off, for the lap events of a slave's lanes.
+// logMillis and logMicros are the trigger's timestamps.
+void ProcessLaneTriggers(byte lanePins, unsigned long logMillis, unsigned long logMicros) {
   // if still in pre-start, declare a fault and return the faulting lane triggers.
   if (state == PreStart) {
-    // We need to debounce the fault trigger, like a regular trigger.
-    // Store fault trigger timestamp in the 1st element, ie the zero index, of the lastXMillis[] array.
-    if( ( logMillis - lastXMillis [0][0] ) > debounceTime ) {
-      // prevState = state;
-      state = PreFault;
-      // state = Fault;
-      lastTriggeredPins = triggeredPins;
-      lastXMillis [0][0] = logMillis;
-    }
+    StartFault(lanePins, logMillis, logMicros);
     return;
   }
 
-  // While the triggeredPins byte is > 0, one of the digits is a 1.
+  // A crossing after a Timed race's deadline only counts if it finishes the racer's current lap, see FINISH_CURRENT_LAP.
+  bool overtime = raceDeadlineOn && (long)(logMillis - raceDeadlineMillis) >= 0;
+
+  // While the lanePins byte is > 0, one of the digits is a 1.
   // If after a check, triggerPins = 0, then there is no need to keep checking.
   // Since we only have 4 bits that can be a 1, this loop will run a max of 4 times.
   // laneNum is index of lanes[] that defiens the pin and intterupt byte determined by hardware.
   byte laneNum = 1;
-  while(triggeredPins > 0){
+  while(lanePins > 0){
     // If bit i is a 1, then process it as a trigger on lane 'laneNum'
-    // if(triggeredPins & lanes[laneNum][1] && (laneEnableStatus[ laneNum ] != Off)){
-    if(triggeredPins & lanes[laneNum][1]){
+    // if(lanePins & lanes[laneNum][1] && (laneEnableStatus[ laneNum ] != Off)){
+    if(lanePins & lanes[laneNum][1]){
       // Depending on the status of this lane we process the trigger differently.
         // Serial.print("lanes[laneNum][1]: ");
         // Serial.println(lanes[laneNum][1]);
@@ -1273,9 +2078,13 @@ ISR (PCINT_VECT) {
       switch (laneEnableStatus[ laneNum ]) {
 
         case StandBy:{
+          // A lane can't start a lap once time is up.
+          if (overtime) break;
           // If in StandBy, no need for debounce
           // Change lane status from 'StandBy' to 'Active'
           laneEnableStatus[ laneNum] = Active;
+          // A restarted lap has no sector split, until the sector sensor is crossed again.
+          sectorLap[ laneNum ] = 0;
           // log current ms timestamp as start time for racer's current lap.
           startMillis[ laneNum ] = logMillis;
           // If the first lap of race
@@ -1295,8 +2104,14 @@ ISR (PCINT_VECT) {
         break;
 
         case Active:{
+          if (overtime && (!FINISH_CURRENT_LAP || lapFinal[ laneNum ])) break;
           // If lane is 'Active' then check that it has not been previously triggerd within debounce period.
-          if( ( logMillis - lastXMillis [ laneNum ] [(lapCount[ laneNum ]-1)%lapMillisQSize] ) > debounceTime ){
+          // A drag lane waiting on its start line crossing (lapCount = 0) has no previous trigger,
+          // so it is checked against que idx 0, which is cleared at the start of the race.
+          if( ( logMillis - lastXMillis [ laneNum ] [(lapCount[ laneNum ] > 0 ? (lapCount[ laneNum ]-1)%lapMillisQSize : 0)] ) > debounceTime ){
+            // Drag lanes log the start line (lapCount 0), and finish line (lapCount 1), crossing in us.
+            if (DragRace() && lapCount[ laneNum ] < 2) dragMicros[ laneNum ][ lapCount[ laneNum ] ] = logMicros;
+            if (overtime) lapFinal[ laneNum ] = true;
             // Set lap display flash status to 1, indicating that racer's lane data needs to be processed.
             flashStatus[ laneNum ] = 1;
             // Log current ms timestamp to racer's looping, lap time, temporary que.
@@ -1319,24 +2134,1502 @@ ISR (PCINT_VECT) {
 
     } // END if triggeredPin & ...
 
-    // Turn checked digit in triggeredPins to zero
-    // triggeredPins = triggeredPins & (lanes[laneNum][1] xor 0b11111111);
-    triggeredPins = triggeredPins & ~lanes[laneNum][1];
+    // Turn checked digit in lanePins to zero
+    // lanePins = lanePins & (lanes[laneNum][1] xor 0b11111111);
+    lanePins = lanePins & ~lanes[laneNum][1];
     laneNum++;
-    // Serial.print("triggeredPins: ");
-    // Serial.println(triggeredPins);
+    // Serial.print("lanePins: ");
+    // Serial.println(lanePins);
     // Serial.println(INTERRUPT_PORT);
 
   } // END of While Loop checking each digit
 
-  // MICROTIMING code
-  // timeTest[timeTestCount] = micros() - logMicros;
-  // timeTestCount++;
+} // END of ProcessLaneTriggers()
 
-} // END of ISR()
-
-
-// // Function returns true if the bit at the, 'pos', postion of a byte is 1,
+// ISR is a special Arduino Macro or routine that handles interrupts ISR(vector, attributes)
+// PCINT1_vect handles pin change interrupt for the pin block A0-A5, represented in bit0-bit5
+// The execution time of this function should be as fast as possible as
+// interrupts are disabled while inside it.
+// This function takes approximately 0.004 - 0.180ms
+// Its execution time is logged to a histogram that can be viewed in the Diagnostics Menu.
+// Use vector 'PCINT1_vect' for ATmega328 based Arduino (ie Nano)
+// Use vector 'PCINT2_vect' for ATmega2560 based Arduino
+// 'PCINT_VECT' is defined in '...Settings.h' files
+ISR (PCINT_VECT) {
+  // The us timestamp is used for drag timing, sensor pulse widths, and the ISR's own execution time.
+  unsigned long logMicros = micros();
+  ReadLaneTriggers(logMicros);
+  LogLatency(isrLatencyHist, micros() - logMicros, ISR_HIST_BASE_SHIFT);
+} // END of ISR()
+
+
+// ******* START LIGHT SEQUENCER ******************
+// The PreStart countdown is run by a 1kHz Timer1 interrupt, rather than by polling millis() in loop().
+// Each start light step, and the green, fall on an exact tick no matter what loop() is doing.
+// At the green, the interrupt takes the race start timestamps, arms the drag lanes, and changes to
+// the Race state, so the official start time doesn't depend on how long a loop() pass takes.
+// The start lights and displays are shared with loop(), so loop() still writes them,
+// showing each step as soon as it sees the interrupt has reached it.
+
+// ms left in the PreStart countdown, counted down by the Timer1 interrupt, 0 when not counting.
+volatile unsigned int startLightTicks = 0;
+// # of start light steps the interrupt has reached, and the # loop() has shown on the lights.
+volatile byte startLightStep = 0;
+byte startLightStepShown = 0;
+// Set by the interrupt at the green, and cleared once loop() has turned the lights green.
+volatile bool startLightGreen = false;
+
+// Starts the 1kHz Timer1 compare interrupt that runs the start light sequence, and the track simulator.
+void TickSetup(){
+  noInterrupts();
+  TCCR1A = 0;
+  // CTC mode, with a prescaler of 64, 16MHz / 64 / (249 + 1) = 1kHz
+  TCCR1B = bit(WGM12) | bit(CS11) | bit(CS10);
+  OCR1A = 249;
+  TIMSK1 |= bit(OCIE1A);
+  interrupts();
+}
+
+// Starts a countdown of 'countdownMillis' to the green, from the next tick.
+// Called at the end of the PreStart entry, so the entry's display updates don't eat into the countdown.
+void StartLightBegin(unsigned int countdownMillis){
+  noInterrupts();
+  startLightStep = 0;
+  startLightStepShown = 0;
+  startLightGreen = false;
+  // Restart the tick period, so the green is due exactly 'countdownMillis' from now.
+  TCNT1 = 0;
+  // A countdown of 0 goes green on the 1st tick.
+  startLightTicks = (countdownMillis > 0 ? countdownMillis : 1);
+  #if BUILD_DRAG
+    dragGreenDueMicros = micros() + startLightTicks * 1000UL;
+  #endif
+  interrupts();
+}
+
+// Runs the PreStart countdown, once every ms. Called from the Timer1 ISR.
+void StartLightTick(){
+  // A pause or fault holds the countdown, it's restarted by the next PreStart entry.
+  if (state != PreStart || startLightTicks == 0) return;
+  startLightTicks--;
+  if (startLightTicks == 0) {
+    // The green. Drag lanes are armed here, before interrupts are back on,
+    // so a launch on the green can't be read as a fault, or logged before the green.
+    greenMillis = millis();
+    #if BUILD_DRAG
+      dragGreenMicros = micros();
+    #endif
+    if (DragRace() && newRace) {
+      // set lanes Active on race start
+      for(byte i = 1; i <= laneCount; i++){
+        if(laneEnableStatus[i] == StandBy){
+          laneEnableStatus[i] = Active;
+          // If using a start and finish line triggers, set lapCount to 0 (or 'false')
+          // If using a finish line only, set lapCount to 1 (or 'true')
+          lapCount[i] = SINGLE_DRAG_TRIGGER;
+          // Flag the lane for the 1st loop() of the race, which marks the race data as existing.
+          flashStatus[i] = 1;
+          startMillis[i] = greenMillis;
+        }
+      }
+    }
+    startLightGreen = true;
+    // Move on to live race, it's now legal for racers to cross start
+    ChangeStateTo(Race);
+  } else if (startLightTicks < nextStageCountdownTime) {
+    // If remaining pre-start countdown drops below next update period, move to the next light.
+    nextStageCountdownTime -= preStartTick;
+    startLightStep++;
+  }
+}
+
+ISR (TIMER1_COMPA_vect) {
+  StartLightTick();
+  MarqueeTick();
+  #if TRACK_SIMULATOR
+    SimTick();
+  #endif
+}
+
+
+// ******* RACE CHECKPOINT & WATCHDOG ******************
+// Reset flags read from MCUSR at boot, before they're cleared.
+byte resetFlags = 0;
+// Optiboot clears MCUSR, and passes its value on in r2. It's saved in .init0, before the C runtime can use r2,
+// to a .noinit variable, so it isn't zeroed with the rest of RAM.
+byte bootResetFlags __attribute__ ((section (".noinit")));
+void SaveBootResetFlags() __attribute__ ((naked, used, section (".init0")));
+void SaveBootResetFlags() {
+  __asm__ __volatile__ ("sts %0, r2\n" : "=m" (bootResetFlags) :);
+}
+// The Arduino core's millis() count, set back on a resume, and moved on by the idle power manager.
+extern volatile unsigned long timer0_millis;
+
+#if RACE_CHECKPOINT
+#if !BUILD_CIRCUIT
+  #error "RACE_CHECKPOINT needs BUILD_CIRCUIT, drag races aren't checkpointed."
+#endif
+// While a race is live, its state is saved to EEPROM, so if the controller is reset, by a brownout or the watchdog,
+// it starts back up in the race, paused, instead of in the main menu.
+// There are CHECKPOINT_SLOTS copies, or slots, of the checkpoint, written to in turn. Each has a sequence # and CRC,
+// so if a reset lands part way through writing 1 slot, the one before it still holds the last whole checkpoint.
+//
+// Writing an EEPROM byte takes ~3.4ms, so a checkpoint is copied to RAM at the top of loop(), outside of lap processing,
+// then written to EEPROM in the background by the EEPROM ready interrupt, 1 byte per interrupt.
+// Each EEPROM byte can be written ~100,000 times. The sequence #, clock, and CRC change on every checkpoint,
+// so the wear is spread over the ring of slots. Bytes that haven't changed since the slot was last written are skipped.
+//
+// Only what's needed to carry on the race is kept: lap counts, last crossing, total time, and best lap of each lane,
+// and the race clock. The rest of each racer's fastest laps list, and their sector bests, start over on a resume.
+// Drag races are over too quickly to be worth resuming.
+const byte checkpointMagic = 0xC1;
+struct CheckpointLane {
+  byte status;
+  byte racer;
+  int laps;
+  // millis() timestamp of the lane's last crossing, the start of its current lap.
+  unsigned long lastCross;
+  unsigned long totalTime;
+  unsigned long bestTime;
+  unsigned int bestLap;
+};
+struct RaceCheckpoint {
+  byte magic;
+  uint16_t seq;
+  // false once the race is over, so there's nothing to resume.
+  bool live;
+  byte type;
+  int laps;
+  int endLap;
+  unsigned long setTimeMs;
+  bool countingDown;
+  byte finished;
+  // millis() when the checkpoint was taken. On a resume the millis() clock is set back to it,
+  // so the saved timestamps carry on as they were.
+  unsigned long clockMillis;
+  unsigned long raceTime;
+  CheckpointLane lane[laneCount];
+  // CRC of all the bytes before it, it's the last field so it's written last.
+  uint16_t crc;
+};
+static_assert(CHECKPOINT_SLOTS >= 2, "CHECKPOINT_SLOTS must be at least 2.");
+static_assert(CHECKPOINT_EEPROM_ADDR + CHECKPOINT_SLOTS * sizeof(RaceCheckpoint) <= E2END + 1, "The race checkpoint doesn't fit in EEPROM.");
+// The checkpoint being written, or the last one written.
+RaceCheckpoint checkpoint;
+// Slot the next checkpoint is written to.
+byte checkpointSlot = 0;
+volatile bool checkpointWriting = false;
+volatile uint16_t checkpointAddr = 0;
+volatile byte checkpointIdx = 0;
+// When, and at what state and total lap count, the last checkpoint was taken.
+unsigned long checkpointMillis = 0;
+states checkpointState = Menu;
+int checkpointLaps = 0;
+
+uint16_t CheckpointCrc() {
+  uint16_t crc = 0xFFFF;
+  const byte *data = (const byte *)&checkpoint;
+  for (byte i = 0; i < offsetof(RaceCheckpoint, crc); i++) crc = _crc16_update(crc, data[i]);
+  return crc;
+}
+
+// Writes the next changed byte of the checkpoint. The interrupt fires whenever the EEPROM is ready,
+// so at most 8 unchanged bytes are skipped over each time, to not hold off the lap interrupts.
+ISR (EE_READY_vect) {
+  const byte *data = (const byte *)&checkpoint;
+  for (byte n = 0; n < 8 && checkpointIdx < sizeof(RaceCheckpoint); n++) {
+    byte idx = checkpointIdx++;
+    EEAR = checkpointAddr + idx;
+    EECR |= bit(EERE);
+    if (EEDR != data[idx]) {
+      EEDR = data[idx];
+      EECR |= bit(EEMPE);
+      EECR |= bit(EEPE);
+      return;
+    }
+  }
+  if (checkpointIdx >= sizeof(RaceCheckpoint)) {
+    EECR &= ~bit(EERIE);
+    checkpointWriting = false;
+  }
+}
+
+// Copies the race into the checkpoint and starts writing it to the next slot.
+// Returns false, without taking it, if a lap has been logged by the ISR but not yet processed by loop().
+bool CheckpointTake(bool live) {
+  int laps = 0;
+  noInterrupts();
+  for (byte i = 1; i <= laneCount; i++) {
+    if (flashStatus[i] == 1) {
+      interrupts();
+      return false;
+    }
+    CheckpointLane &ln = checkpoint.lane[i - 1];
+    ln.status = laneEnableStatus[i];
+    ln.laps = lapCount[i];
+    ln.lastCross = (lapCount[i] > 0 ? lastXMillis[i][(lapCount[i] - 1) % lapMillisQSize] : 0);
+    laps += lapCount[i];
+  }
+  checkpoint.clockMillis = millis();
+  interrupts();
+  for (byte i = 1; i <= laneCount; i++) {
+    CheckpointLane &ln = checkpoint.lane[i - 1];
+    ln.racer = laneRacer[i];
+    ln.totalTime = racersTotalTime[i];
+    ln.bestTime = fastestTimes[i][0];
+    ln.bestLap = fastestLaps[i][0];
+  }
+  checkpoint.magic = checkpointMagic;
+  checkpoint.seq++;
+  checkpoint.live = live;
+  checkpoint.type = raceType;
+  checkpoint.laps = raceLaps;
+  checkpoint.endLap = endLap;
+  checkpoint.setTimeMs = raceSetTimeMs;
+  checkpoint.countingDown = countingDown;
+  checkpoint.finished = finishedCount;
+  checkpoint.raceTime = currentTime[0];
+  checkpoint.crc = CheckpointCrc();
+
+  checkpointMillis = checkpoint.clockMillis;
+  checkpointState = state;
+  checkpointLaps = laps;
+  checkpointAddr = CHECKPOINT_EEPROM_ADDR + checkpointSlot * sizeof(RaceCheckpoint);
+  checkpointSlot = (checkpointSlot + 1) % CHECKPOINT_SLOTS;
+  checkpointIdx = 0;
+  checkpointWriting = true;
+  EECR |= bit(EERIE);
+  return true;
+}
+
+// Run at the top of every loop(), before any of the loop's laps are processed.
+// A checkpoint is taken on every change of race state, when laps have been logged since the last, at most every
+// CHECKPOINT_MS, and for the race clock alone every CHECKPOINT_CLOCK_MS. Once the race is over, the last is closed.
+void CheckpointUpdate() {
+  if (checkpointWriting) return;
+  bool live = !DragRace() && (state == Race || state == Paused || (state == PreStart && !newRace));
+  if (!live) {
+    if (checkpoint.live) CheckpointTake(false);
+    return;
+  }
+  unsigned long sinceLast = millis() - checkpointMillis;
+  if (state == checkpointState && checkpoint.live) {
+    if (sinceLast < CHECKPOINT_MS) return;
+    if (sinceLast < CHECKPOINT_CLOCK_MS) {
+      int laps = 0;
+      noInterrupts();
+      for (byte i = 1; i <= laneCount; i++) laps += lapCount[i];
+      interrupts();
+      if (laps == checkpointLaps) return;
+    }
+    // The race clock doesn't move while paused.
+    if (state == Paused && sinceLast >= CHECKPOINT_CLOCK_MS) return;
+  }
+  CheckpointTake(true);
+}
+
+// Reads a slot into the checkpoint, returns true if it holds a whole checkpoint.
+bool CheckpointRead(byte slot) {
+  eeprom_read_block(&checkpoint, (const void *)(CHECKPOINT_EEPROM_ADDR + slot * sizeof(RaceCheckpoint)), sizeof(RaceCheckpoint));
+  return checkpoint.magic == checkpointMagic && checkpoint.crc == CheckpointCrc();
+}
+
+// Run once in setup(). Finds the latest whole checkpoint, and if its race was still live, restores it.
+// Returns true if there's a race to resume.
+bool CheckpointResume() {
+  // The latest is the whole checkpoint with the highest sequence #. They're compared as a difference, so they can roll over.
+  int latest = -1;
+  uint16_t latestSeq = 0;
+  for (byte slot = 0; slot < CHECKPOINT_SLOTS; slot++) {
+    if (!CheckpointRead(slot)) continue;
+    if (latest < 0 || (int16_t)(checkpoint.seq - latestSeq) > 0) {
+      latest = slot;
+      latestSeq = checkpoint.seq;
+    }
+  }
+  if (latest < 0) {
+    memset(&checkpoint, 0, sizeof(RaceCheckpoint));
+    return false;
+  }
+  CheckpointRead(latest);
+  checkpointSlot = (latest + 1) % CHECKPOINT_SLOTS;
+  if (!checkpoint.live) return false;
+
+  // Carry on the millis() clock from the checkpoint.
+  noInterrupts();
+  timer0_millis = checkpoint.clockMillis;
+  interrupts();
+  raceType = (races)checkpoint.type;
+  raceLaps = checkpoint.laps;
+  endLap = checkpoint.endLap;
+  raceSetTimeMs = checkpoint.setTimeMs;
+  countingDown = checkpoint.countingDown;
+  finishedCount = checkpoint.finished;
+  currentTime[0] = checkpoint.raceTime;
+  enabledLaneCount = 0;
+  for (byte i = 1; i <= laneCount; i++) {
+    CheckpointLane &ln = checkpoint.lane[i - 1];
+    laneEnableStatus[i] = ln.status;
+    SetLaneRacer(i, ln.racer);
+    lapCount[i] = ln.laps;
+    if (ln.laps > 0) lastXMillis[i][(ln.laps - 1) % lapMillisQSize] = ln.lastCross;
+    startMillis[i] = ln.lastCross;
+    racersTotalTime[i] = ln.totalTime;
+    fastestTimes[i][0] = ln.bestTime;
+    fastestLaps[i][0] = ln.bestLap;
+    if (ln.status != Off) enabledLaneCount++;
+  }
+  newRace = false;
+  raceDataExists = true;
+  checkpointState = Paused;
+  checkpointMillis = checkpoint.clockMillis;
+
+  lcd.clear();
+  lcd.print(F("Race resumed"));
+  lcd.setCursor(0, 1);
+  if (resetFlags & bit(WDRF)) lcd.print(F("after watchdog reset"));
+  else if (resetFlags & bit(BORF)) lcd.print(F("after brownout"));
+  delay(2000);
+  lcd.clear();
+  PrintLeaderBoard(true);
+  return true;
+}
+#endif
+
+
+// ******* IDLE POWER MANAGER ******************
+// While in the menus, or on the finish screen, the controller is only waiting on a key or button press.
+// Instead of spinning loop(), it sleeps at the end of each loop until the next interrupt.
+// In 'idle' sleep the timers, ADC, and I2C keep running, so the next interrupt (within 1ms) wakes it,
+// and there's no added key latency. Only the CPU clock is stopped, roughly quartering its current.
+//
+// After IDLE_POWER_DOWN_MS in the menus without a key or button press, it goes into 'power down' sleep instead,
+// which stops all its clocks. It's woken by a keypad pin change interrupt, or by the watchdog timer every
+// ~64ms, so the Start and Pause buttons, which are on analog only pins, can be sampled by the ADC.
+// The timers don't run in power down, so millis() is moved on by the watchdog period on each watchdog wake.
+// Power down is only used with KEYPAD_INTERRUPTS, as a polled keypad can't wake it.
+const bool idlePowerDownOn = (IDLE_POWER_DOWN_MS > 0 && KEYPAD_INTERRUPTS && !TRACK_SIMULATOR && !LINK_NODE);
+// Watchdog wake period in ms, set by WDP1 (8K WDT oscillator cycles).
+const byte idleWdtMillis = 64;
+// Time kept awake after each wake, for the ADC to sample both buttons on Timer0 overflows.
+const byte idleAwakeMillis = 3;
+// Set by updatePlayRtttl(), a song's notes are timed by loop(), so it must keep running.
+bool songPlaying = false;
+volatile bool idlePoweredDown = false;
+unsigned long idleWakeMillis = 0;
+
+// Watchdog interrupt, only enabled during power down.
+ISR (WDT_vect) {
+  if (idlePoweredDown) timer0_millis += idleWdtMillis;
+}
+
+bool IdlePowerDownReady() {
+  if (!idlePowerDownOn) return false;
+  // The lane sensors are live in the diagnostics menu, and timed with micros(), which stops in power down.
+  if (state != Menu || currentMenu == DiagnosticsMenu) return false;
+  if (songPlaying || MarqueeActive()) return false;
+  #if RACE_CHECKPOINT
+    // The EEPROM ready interrupt can't wake it from power down.
+    if (checkpointWriting) return false;
+  #endif
+  #if DISPLAY_COPROC == 1
+    // Power down would stop the UART part way through a frame to the display coprocessor.
+    if (Serial.availableForWrite() < SERIAL_TX_BUFFER_SIZE - 1) return false;
+  #endif
+  #if I2C_ASYNC
+    if (twiBusy) return false;
+  #endif
+  unsigned long now = millis();
+  return (now - idleInputMillis > IDLE_POWER_DOWN_MS && now - idleWakeMillis >= idleAwakeMillis);
+}
+
+void IdlePowerDown() {
+  // The ADC is left on in every sleep mode, unless it's turned off.
+  ADCSRA &= ~bit(ADEN);
+  noInterrupts();
+  // Watchdog in interrupt only mode, ~64ms.
+  MCUSR &= ~bit(WDRF);
+  WDTCSR = bit(WDCE) | bit(WDE);
+  WDTCSR = bit(WDIE) | bit(WDP1);
+  idlePoweredDown = true;
+  set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+  sleep_enable();
+  interrupts();
+  sleep_cpu();
+  sleep_disable();
+  noInterrupts();
+  idlePoweredDown = false;
+  // Put the watchdog back to resetting the controller, or off.
+  #if WATCHDOG
+    wdt_enable(WATCHDOG_TIMEOUT);
+  #else
+    wdt_disable();
+  #endif
+  interrupts();
+  ADCSRA |= bit(ADEN);
+  idleWakeMillis = millis();
+}
+
+// Run at the end of every loop().
+void IdleSleep() {
+  if (!IDLE_SLEEP || (state != Menu && state != Finish)) return;
+  unsigned long sleepMicros = micros();
+  if (IdlePowerDownReady()) {
+    IdlePowerDown();
+  } else {
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+  }
+  // Time asleep isn't logged as loop() time.
+  loopStartMicros += micros() - sleepMicros;
+}
+
+
+// ******* LINKED CONTROLLERS ******************
+#if LINK_NODE
+#if DIAGNOSTICS_SERIAL
+  #error "DIAGNOSTICS_SERIAL can't be used with LINK_NODE, they both use the serial port."
+#endif
+// Linked controllers talk over the UART (pins 0 RX & 1 TX), with their own interrupts instead of 'Serial',
+// so each frame can be timestamped in the interrupt that sends or receives its 1st byte.
+// The master's TX is wired to every slave's RX. Each slave's TX is wired to the master's RX through a diode,
+// and a slave only drives its TX while it replies, so only the master starts a transfer.
+//
+// Frame layout: SOF, to node, from node, type, sender's micros() (4 bytes, LSB 1st), payload size, payload, checksum.
+// The sender's micros() is filled in by the interrupt, as the SOF is sent.
+//
+// The master polls each slave in turn. A slave replies with the poll's sent and received timestamps, and its
+// lap events. From the poll's send (t1), and receive (t2), and the reply's send (t3), and receive (t4),
+// the master works out the slave's clock offset, as ((t2 - t1) + (t3 - t4)) / 2, which cancels the link delay.
+// The offset is averaged across polls, and its rate of change, the drift between the 2 clocks, is tracked
+// so a slave timestamp is put on the master's clock as accurately between polls, as at them.
+const byte linkSOF = 0xA5;
+const byte linkHeaderSize = 9;
+const byte linkMaxEvents = 4;
+// A reply holds a seq #, t1, t2, an event count, and up to linkMaxEvents lane #s with their micros().
+const byte linkMaxPayload = 10 + linkMaxEvents * 5;
+const byte linkFrameSize = linkHeaderSize + linkMaxPayload + 1;
+
+// Frame being received, and the micros() its SOF arrived.
+volatile byte linkRx[linkFrameSize];
+volatile byte linkRxLen = 0;
+volatile unsigned long linkRxMicros = 0;
+// Last received frame addressed to this node, waiting for loop(), and the micros() its SOF arrived.
+volatile byte linkFrame[linkFrameSize];
+volatile bool linkFrameReady = false;
+volatile unsigned long linkFrameMicros = 0;
+// Frame being sent, its length without the checksum, idx of the next byte to send, and running checksum.
+volatile byte linkTx[linkFrameSize];
+volatile byte linkTxLen = 0;
+volatile byte linkTxIdx = 0;
+volatile byte linkTxSum = 0;
+volatile bool linkTxBusy = false;
+// Frames received with a framing or checksum error, and slave lap events dropped with the queue full.
+volatile unsigned int linkErrorCount = 0;
+
+#if LINK_NODE == 1
+// Master's estimate of each slave's clock, idx by node #.
+// Slave micros() - master micros(), at master micros() linkSyncMicros.
+unsigned long linkOffset[LINK_NODES + 1] = {};
+unsigned long linkSyncMicros[LINK_NODES + 1] = {};
+// Rate the slave's clock gains on the master's, in parts per million, and if it's been measured yet.
+long linkDriftPpm[LINK_NODES + 1] = {};
+bool linkDriftKnown[LINK_NODES + 1] = {};
+// Offset, and master micros(), the drift is next measured from, about once a second.
+unsigned long linkDriftRefOffset[LINK_NODES + 1] = {};
+unsigned long linkDriftRefMicros[LINK_NODES + 1] = {};
+bool linkSynced[LINK_NODES + 1] = {};
+// Seq # of the last reply from each slave, sent back in the next poll to acknowledge its events.
+byte linkAckSeq[LINK_NODES + 1] = {};
+// millis() of the last reply received, and its round trip time in us, less the slave's time to reply.
+unsigned long linkReplyMillis[LINK_NODES + 1] = {};
+unsigned int linkRttMicros[LINK_NODES + 1] = {};
+// Next slave to poll, and millis() of the last poll.
+byte linkPollNode = 2;
+unsigned long linkPollMillis = 0;
+#else
+// Slave's queue of lane triggers, the master's lane # and micros() of each, waiting to be sent.
+const byte linkEventQSize = 8;
+volatile byte linkEventLane[linkEventQSize];
+volatile unsigned long linkEventMicros[linkEventQSize];
+volatile byte linkEventHead = 0;
+volatile byte linkEventTail = 0;
+// Events in the last reply, kept in the queue until the master acknowledges its seq #.
+byte linkSentCount = 0;
+byte linkSeq = 1;
+unsigned int linkPollCount = 0;
+unsigned int linkEventCount = 0;
+unsigned long linkDisplayMillis = 0;
+#endif
+
+// Writes, and reads, a 4 byte value, LSB 1st, to a frame buffer.
+void LinkPut32(volatile byte buf[], byte idx, unsigned long value) {
+  for (byte i = 0; i < 4; i++) buf[idx + i] = value >> (8 * i);
+}
+unsigned long LinkGet32(const volatile byte buf[], byte idx) {
+  unsigned long value = 0;
+  for (byte i = 0; i < 4; i++) value |= (unsigned long)buf[idx + i] << (8 * i);
+  return value;
+}
+
+// Sets the UART to LINK_BAUD 8N1, with receive, send, and send complete interrupts.
+// A slave only turns its transmitter on while it's sending a reply, so its TX pin is left as an input.
+void LinkSetup() {
+  noInterrupts();
+  UCSR0A = bit(U2X0);
+  UBRR0 = ((F_CPU / 4 / LINK_BAUD) - 1) / 2;
+  UCSR0C = bit(UCSZ01) | bit(UCSZ00);
+  UCSR0B = bit(RXEN0) | bit(RXCIE0) | bit(TXCIE0) | (LINK_NODE == 1 ? bit(TXEN0) : 0);
+  interrupts();
+  #if LINK_NODE > 1
+    pinMode(1, INPUT);
+    linkSeq = micros() | 1;
+  #endif
+}
+
+// Starts sending a frame, returns false if the last one is still being sent.
+bool LinkSend(byte to, linkFrames type, const byte payload[], byte size) {
+  if (linkTxBusy) return false;
+  linkTx[0] = linkSOF;
+  linkTx[1] = to;
+  linkTx[2] = LINK_NODE;
+  linkTx[3] = type;
+  linkTx[8] = size;
+  for (byte i = 0; i < size; i++) linkTx[linkHeaderSize + i] = payload[i];
+  linkTxLen = linkHeaderSize + size;
+  linkTxIdx = 0;
+  linkTxSum = 0;
+  linkTxBusy = true;
+  noInterrupts();
+  UCSR0B |= bit(TXEN0) | bit(UDRIE0);
+  interrupts();
+  return true;
+}
+
+// UART data register empty, load the next byte of the frame.
+ISR(USART_UDRE_vect) {
+  byte data;
+  // The send timestamp is taken as the SOF starts, the rest of the header hasn't been sent yet.
+  if (linkTxIdx == 0) LinkPut32(linkTx, 4, micros());
+  if (linkTxIdx < linkTxLen) {
+    data = linkTx[linkTxIdx];
+    if (linkTxIdx > 0) linkTxSum += data;
+  } else {
+    data = linkTxSum;
+    UCSR0B &= ~bit(UDRIE0);
+  }
+  linkTxIdx++;
+  UDR0 = data;
+}
+
+// UART send complete, the checksum has been shifted out.
+ISR(USART_TX_vect) {
+  if (linkTxIdx <= linkTxLen) return;
+  // A slave releases its TX line, so the other slaves can reply.
+  if (LINK_NODE > 1) UCSR0B &= ~bit(TXEN0);
+  linkTxBusy = false;
+}
+
+// UART byte received, timestamp a frame's SOF, and pass a complete frame for this node on to loop().
+ISR(USART_RX_vect) {
+  unsigned long rxMicros = micros();
+  bool rxError = UCSR0A & (bit(FE0) | bit(DOR0));
+  byte data = UDR0;
+  if (rxError) {
+    linkRxLen = 0;
+    linkErrorCount++;
+    return;
+  }
+  if (linkRxLen == 0) {
+    if (data != linkSOF) return;
+    linkRxMicros = rxMicros;
+  }
+  linkRx[linkRxLen++] = data;
+  if (linkRxLen == linkHeaderSize && linkRx[8] > linkMaxPayload) {
+    linkRxLen = 0;
+    linkErrorCount++;
+    return;
+  }
+  if (linkRxLen < linkHeaderSize || linkRxLen < linkHeaderSize + linkRx[8] + 1) return;
+  byte sum = 0;
+  for (byte i = 1; i < linkRxLen - 1; i++) sum += linkRx[i];
+  if (sum != linkRx[linkRxLen - 1]) {
+    linkErrorCount++;
+  } else if (linkRx[1] == LINK_NODE && !linkFrameReady) {
+    for (byte i = 0; i < linkRxLen; i++) linkFrame[i] = linkRx[i];
+    linkFrameMicros = linkRxMicros;
+    linkFrameReady = true;
+  }
+  linkRxLen = 0;
+}
+
+#if LINK_NODE == 1
+// Returns the slave's clock offset at master micros() 'atMicros', using its drift since the last sync.
+unsigned long LinkSlaveOffset(byte node, unsigned long atMicros) {
+  long sinceSyncMillis = (long)(atMicros - linkSyncMicros[node]) / 1000;
+  return linkOffset[node] + sinceSyncMillis * linkDriftPpm[node] / 1000;
+}
+
+// Updates a slave's clock offset and drift from a poll's timestamps, t1 to t4 as described above.
+void LinkSync(byte node, unsigned long t1, unsigned long t2, unsigned long t3, unsigned long t4) {
+  unsigned long toSlave = t2 - t1;
+  unsigned long fromSlave = t3 - t4;
+  // The time the frames spent on the link, there and back. Half of it is taken off the measured offset.
+  long rtt = (long)(toSlave - fromSlave);
+  if (rtt < 0) return;
+  linkRttMicros[node] = (rtt > 0xFFFF ? 0xFFFF : rtt);
+  unsigned long sample = toSlave - rtt / 2;
+  if (!linkSynced[node]) {
+    linkOffset[node] = sample;
+    linkDriftRefOffset[node] = sample;
+    linkDriftRefMicros[node] = t4;
+    linkSynced[node] = true;
+  } else {
+    // Move a 1/4 of the way from the predicted offset to the measured one, to smooth out interrupt jitter.
+    unsigned long predicted = LinkSlaveOffset(node, t4);
+    linkOffset[node] = predicted + (long)(sample - predicted) / 4;
+  }
+  linkSyncMicros[node] = t4;
+  // Measure the drift over at least a second, so the timestamp jitter is small against the change in offset.
+  unsigned long driftPeriod = t4 - linkDriftRefMicros[node];
+  if (driftPeriod >= 1000000) {
+    long measuredPpm = (long)(linkOffset[node] - linkDriftRefOffset[node]) * 1000 / (long)(driftPeriod / 1000);
+    linkDriftPpm[node] = (linkDriftKnown[node] ? linkDriftPpm[node] + (measuredPpm - linkDriftPpm[node]) / 4 : measuredPpm);
+    linkDriftKnown[node] = true;
+    linkDriftRefOffset[node] = linkOffset[node];
+    linkDriftRefMicros[node] = t4;
+  }
+}
+
+// Handles a slave's reply, syncing its clock, then timing its new lap events on the master's clock.
+void LinkHandleReply(byte frame[], unsigned long rxMicros) {
+  byte node = frame[2];
+  if (node < 2 || node > LINK_NODES) return;
+  linkReplyMillis[node] = millis();
+  byte seq = frame[linkHeaderSize];
+  LinkSync(node, LinkGet32(frame, linkHeaderSize + 1), LinkGet32(frame, linkHeaderSize + 5), LinkGet32(frame, 4), rxMicros);
+  // A repeated seq # is a reply resent because the poll acknowledging it was lost, its events are already in.
+  if (seq == linkAckSeq[node]) return;
+  linkAckSeq[node] = seq;
+  byte count = frame[linkHeaderSize + 9];
+  for (byte i = 0; i < count && i < linkMaxEvents; i++) {
+    byte lane = frame[linkHeaderSize + 10 + i * 5];
+    unsigned long slaveMicros = LinkGet32(frame, linkHeaderSize + 11 + i * 5);
+    if (lane < 1 || lane > laneCount || !(LINK_REMOTE_LANES & (1 << (lane - 1)))) continue;
+    // Put the trigger on the master's clock, then work out its millis() from how long ago it was.
+    unsigned long logMicros = slaveMicros - LinkSlaveOffset(node, slaveMicros - linkOffset[node]);
+    noInterrupts();
+    unsigned long logMillis = millis() - (micros() - logMicros) / 1000;
+    // Lane triggers are only counted outside of the menus, the same as a local trigger.
+    // A slave's crossing can arrive after the green, when it was made before it, and that's still a start fault.
+    if (state != Menu) {
+      if ((long)(logMillis - greenMillis) < 0) StartFault(lanes[lane][1], logMillis, logMicros);
+      else ProcessLaneTriggers(lanes[lane][1], logMillis, logMicros);
+    }
+    interrupts();
+  }
+}
+
+// Polls the next slave, every LINK_POLL_MS. Called every loop().
+void LinkMasterPoll() {
+  if (millis() - linkPollMillis < LINK_POLL_MS) return;
+  byte ack = linkAckSeq[linkPollNode];
+  if (!LinkSend(linkPollNode, LinkPoll, &ack, 1)) return;
+  linkPollMillis = millis();
+  linkPollNode = (linkPollNode >= LINK_NODES ? 2 : linkPollNode + 1);
+}
+#else
+// Queues a lane trigger to be sent to the master. Called from the lane ISR.
+void LinkQueueEvent(byte lane, unsigned long logMicros) {
+  byte next = (linkEventHead + 1) % linkEventQSize;
+  if (next == linkEventTail) {
+    linkErrorCount++;
+    return;
+  }
+  linkEventLane[linkEventHead] = lane;
+  linkEventMicros[linkEventHead] = logMicros;
+  linkEventHead = next;
+}
+
+// Replies to a poll with its timestamps, and the oldest queued lap events.
+void LinkHandlePoll(byte frame[], unsigned long rxMicros) {
+  linkPollCount++;
+  // If the master got the last reply's events, they can be dropped from the queue.
+  if (linkSentCount > 0 && frame[linkHeaderSize] == linkSeq) {
+    linkEventTail = (linkEventTail + linkSentCount) % linkEventQSize;
+    linkEventCount += linkSentCount;
+    linkSentCount = 0;
+  }
+  // The same events are resent until they're acknowledged. Only then are the next ones sent, with a new seq #.
+  if (linkSentCount == 0) {
+    noInterrupts();
+    byte queued = (linkEventHead + linkEventQSize - linkEventTail) % linkEventQSize;
+    interrupts();
+    linkSentCount = (queued > linkMaxEvents ? linkMaxEvents : queued);
+    if (linkSentCount > 0) linkSeq++;
+  }
+  byte payload[linkMaxPayload];
+  payload[0] = linkSeq;
+  LinkPut32(payload, 1, LinkGet32(frame, 4));
+  LinkPut32(payload, 5, rxMicros);
+  payload[9] = linkSentCount;
+  for (byte i = 0; i < linkSentCount; i++) {
+    byte idx = (linkEventTail + i) % linkEventQSize;
+    payload[10 + i * 5] = linkEventLane[idx];
+    LinkPut32(payload, 11 + i * 5, linkEventMicros[idx]);
+  }
+  LinkSend(1, LinkReply, payload, 10 + linkSentCount * 5);
+}
+
+// A slave doesn't run a race, this replaces loop(), and shows the link status on its LCD.
+void LinkSlaveLoop() {
+  LinkUpdate();
+  if (millis() - linkDisplayMillis < 500) return;
+  linkDisplayMillis = millis();
+  lcd.setCursor(0, 0);
+  lcd.print(F("Linked Slave  Node"));
+  PrintNumbers(LINK_NODE, 2, 19, lcdDisp, false, 0);
+  lcd.setCursor(0, 1);
+  lcd.print(F("Lanes:"));
+  PrintNumbers(LINK_FIRST_LANE, 1, 7, lcdDisp, false, 1);
+  lcd.print(F("-"));
+  PrintNumbers(LINK_FIRST_LANE + laneCount - 1, 1, 9, lcdDisp, false, 1);
+  lcd.setCursor(0, 2);
+  lcd.print(F("Polls:"));
+  PrintNumbers(linkPollCount, 5, 11, lcdDisp, false, 2);
+  lcd.setCursor(0, 3);
+  lcd.print(F("Laps:       Err:"));
+  PrintNumbers(linkEventCount, 5, 10, lcdDisp, false, 3);
+  PrintNumbers(linkErrorCount > 999 ? 999 : linkErrorCount, 3, 19, lcdDisp, false, 3);
+}
+#endif
+
+// Handles a received frame, and for the master, sends the next poll. Called every loop().
+void LinkUpdate() {
+  if (linkFrameReady) {
+    byte frame[linkFrameSize];
+    noInterrupts();
+    for (byte i = 0; i < linkFrameSize; i++) frame[i] = linkFrame[i];
+    unsigned long rxMicros = linkFrameMicros;
+    linkFrameReady = false;
+    interrupts();
+    #if LINK_NODE == 1
+      if (frame[3] == LinkReply) LinkHandleReply(frame, rxMicros);
+    #else
+      if (frame[3] == LinkPoll) LinkHandlePoll(frame, rxMicros);
+    #endif
+  }
+  #if LINK_NODE == 1
+    LinkMasterPoll();
+  #endif
+}
+
+#if LINK_NODE == 1
+// Diagnostics Menu page, with each slave's link timing.
+void PrintLinkReport() {
+  lcd.print(F("Link ppm  RTT  C|Nxt"));
+  for (byte node = 2; node <= LINK_NODES && node <= 4; node++) {
+    byte row = node - 1;
+    lcd.setCursor(0, row);
+    lcd.print(F("N"));
+    PrintNumbers(node, 1, 1, lcdDisp, false, row);
+    if (!linkSynced[node]) {
+      PrintText("no reply", lcdDisp, 19, 17, false, row);
+      continue;
+    }
+    // drift, in ppm
+    PrintSpanOfChars(lcdDisp, row, 3, 19);
+    if (linkDriftPpm[node] < 0) PrintText("-", lcdDisp, 3, 1, true, row, false);
+    long drift = (linkDriftPpm[node] < 0 ? -linkDriftPpm[node] : linkDriftPpm[node]);
+    PrintNumbers(drift > 9999 ? 9999 : drift, 4, 7, lcdDisp, false, row);
+    PrintNumbers(linkRttMicros[node] > 9999 ? 9999 : linkRttMicros[node], 4, 13, lcdDisp, false, row);
+    // A slave that's stopped replying keeps its last timing, flagged as lost.
+    if (millis() - linkReplyMillis[node] > 1000) PrintText("lost", lcdDisp, 19, 4, false, row, false);
+  }
+}
+#endif
+#endif
+
+// ******* DISPLAY COPROCESSOR ******************
+#if DISPLAY_COPROC
+#if LINK_NODE
+  #error "DISPLAY_COPROC can't be used with LINK_NODE, they both use the serial port."
+#endif
+#if DIAGNOSTICS_SERIAL && DISPLAY_COPROC == 1
+  #error "DIAGNOSTICS_SERIAL can't be used with DISPLAY_COPROC, they both use the serial port."
+#endif
+#endif
+
+#if DISPLAY_COPROC > 1
+// This board is the display coprocessor. It runs the commands received from the controller, see DisplayCoprocessor.h,
+// through the same display drivers the controller would use, and keeps each lane's running clock going by itself.
+// With DISPLAY_COPROC 3 it's a stand-in for testing, that prints the displays to a serial terminal,
+// over the same UART's TX pin, instead of driving any display hardware.
+
+// Frame being received.
+byte coprocRx[4 + coprocMaxPayload];
+byte coprocRxLen = 0;
+// Frames dropped for a bad checksum or size.
+unsigned int coprocErrorCount = 0;
+// Each lane's running clock: if it's running, the millis() it started from, and where it's printed.
+bool coprocClockOn[LANE_COUNT] = {};
+unsigned long coprocClockStart[LANE_COUNT];
+byte coprocClockEnd[LANE_COUNT];
+byte coprocClockWidth[LANE_COUNT];
+byte coprocClockPrecision[LANE_COUNT];
+unsigned long coprocTickMillis = 0;
+#if DISPLAY_COPROC == 3
+  // Start light tree columns lit, and the bargraph LED colors, as characters.
+  byte termLights = 0;
+  byte termLightsUnit = 255;
+  char termBar[24];
+  unsigned long termPrintMillis = 0;
+#endif
+
+void CoprocSetup() {
+  Serial.begin(COPROC_BAUD);
+  #if DISPLAY_COPROC == 2
+    for (byte deviceID = 0; deviceID < LED_BAR_COUNT; deviceID++) {
+      lc.shutdown(deviceID, false);
+      lc.setIntensity(deviceID, 8);
+      lc.clearDisplay(deviceID);
+    }
+    #if !BUILD_BARGRAPH
+    #elif I2C_ASYNC
+      TwiSetup();
+      BargraphSetup();
+    #else
+      bar.begin(BARGRAPH_I2C_ADDRESS);
+    #endif
+    // The Timer1 tick scrolls long names.
+    TickSetup();
+  #else
+    for (byte u = 0; u < LED_BAR_COUNT; u++) TermDriver::Span(u, 0, 0, LED_DIGITS - 1, ' ');
+    memset(termBar, '.', sizeof(termBar));
+  #endif
+  #if WATCHDOG
+    wdt_enable(WATCHDOG_TIMEOUT);
+  #endif
+}
+
+unsigned long CoprocGet32(const byte buf[], byte idx) {
+  unsigned long value = 0;
+  for (byte i = 0; i < 4; i++) value |= (unsigned long)buf[idx + i] << (8 * i);
+  return value;
+}
+
+#if DISPLAY_COPROC == 3
+// Runs a raw LedControl call on the terminal's copy of the displays.
+// A raw segment pattern is shown as the font character that draws it.
+void TermLedRaw(byte unit, coprocLedOps op, byte a, byte b, byte c) {
+  if (op == CpLedSet) {
+    // Only the start light tree is lit by single LEDs. Each of its columns is lit in both rows, so only row 0 is kept.
+    termLightsUnit = unit;
+    if (a == 0) termLights = c ? termLights | bit(b) : termLights & ~bit(b);
+  } else if (op == CpLedClear) {
+    if (unit == termLightsUnit) termLights = 0;
+    TermDriver::Span(unit, 0, 0, LED_DIGITS - 1, ' ');
+  } else if (op == CpLedDigit && a < LED_DIGITS) {
+    TermDriver::Digit(unit, 0, (LED_DIGITS - 1) - a, b, c);
+  } else if (op == CpLedRow && a < LED_DIGITS) {
+    char shown = '?';
+    for (byte ch = ' '; ch < 128; ch++) {
+      if (pgm_read_byte(&segmentFont[ch]) == (b & 0x7F)) {
+        shown = ch;
+        break;
+      }
+    }
+    TermDriver::Char(unit, 0, (LED_DIGITS - 1) - a, shown);
+    termDps[unit][(LED_DIGITS - 1) - a] = b & 0x80;
+  }
+  termChanged = true;
+}
+#endif
+
+// Runs a received command.
+void CoprocRun(coprocCmds cmd, const byte p[], byte size) {
+  if (cmd == CpBar) {
+    if (size < 3) return;
+    #if DISPLAY_COPROC == 2
+      setBargraph(p[0], p[1], p[2]);
+    #else
+      for (byte i = p[2]; i <= p[1] && i < 24; i++) termBar[i] = (p[0] == LED_RED ? 'R' : p[0] == LED_YELLOW ? 'Y' : p[0] == LED_GREEN ? 'G' : '.');
+      termChanged = true;
+    #endif
+    return;
+  }
+  if (size < 1 || p[0] >= LED_BAR_COUNT) return;
+  byte unit = p[0];
+  // Any write to a bar, other than starting its clock, stops its clock.
+  if (unit < LANE_COUNT) coprocClockOn[unit] = (cmd == CpClockRun);
+  switch (cmd) {
+    case CpLedRaw:{
+      if (size < 5) return;
+      #if DISPLAY_COPROC == 2
+        switch (p[1]) {
+          case CpLedShutdown: lc.shutdown(unit, p[2]); break;
+          case CpLedIntensity: lc.setIntensity(unit, p[2]); break;
+          case CpLedClear: LedDriver::MarqueeStop(unit); lc.clearDisplay(unit); break;
+          case CpLedSet: lc.setLed(unit, p[2], p[3], p[4]); break;
+          case CpLedRow: LedDriver::MarqueeStop(unit); lc.setRow(unit, p[2], p[3]); break;
+          case CpLedDigit: LedDriver::MarqueeStop(unit); lc.setDigit(unit, p[2], p[3], p[4]); break;
+          default: break;
+        }
+      #else
+        TermLedRaw(unit, (coprocLedOps)p[1], p[2], p[3], p[4]);
+      #endif
+    }
+    break;
+    case CpSpan:{
+      if (size < 4) return;
+      PrintSpanOn<LaneDisplay>(unit, 0, p[1], p[2], p[3]);
+    }
+    break;
+    case CpText:{
+      if (size < 4) return;
+      char text[coprocMaxPayload + 1];
+      byte len = size - 4;
+      memcpy(text, &p[4], len);
+      text[len] = '\0';
+      PrintTextOn<LaneDisplay>(unit, text, p[1], p[2], p[3] & 1, 0, p[3] & 2);
+    }
+    break;
+    case CpNumber:{
+      if (size < 8) return;
+      PrintNumbersOn<LaneDisplay>(unit, CoprocGet32(p, 1), p[5], p[6], p[7] & 1, 0, p[7] & 2);
+    }
+    break;
+    case CpClock:{
+      if (size < 9) return;
+      PrintClockOn<LaneDisplay>(unit, CoprocGet32(p, 1), p[5], p[6], p[7], 0, p[8]);
+    }
+    break;
+    case CpClockRun:{
+      if (size < 8 || unit >= LANE_COUNT) return;
+      coprocClockStart[unit] = millis() - CoprocGet32(p, 1);
+      coprocClockEnd[unit] = p[5];
+      coprocClockWidth[unit] = p[6];
+      coprocClockPrecision[unit] = p[7];
+      // Drawn on the next tick.
+      coprocTickMillis = millis() - COPROC_CLOCK_MS;
+    }
+    break;
+    default:
+    break;
+  }
+}
+
+// Adds a received byte to the frame, and runs the frame once it's complete.
+void CoprocRead(byte data) {
+  if (coprocRxLen == 0 && data != coprocSOF) return;
+  coprocRx[coprocRxLen++] = data;
+  if (coprocRxLen == 3 && coprocRx[2] > coprocMaxPayload) {
+    coprocRxLen = 0;
+    coprocErrorCount++;
+    return;
+  }
+  if (coprocRxLen < 3 || coprocRxLen < 4 + coprocRx[2]) return;
+  byte sum = 0;
+  for (byte i = 1; i < coprocRxLen - 1; i++) sum += coprocRx[i];
+  if (sum == coprocRx[coprocRxLen - 1]) CoprocRun((coprocCmds)coprocRx[1], &coprocRx[3], coprocRx[2]);
+  else coprocErrorCount++;
+  coprocRxLen = 0;
+}
+
+#if DISPLAY_COPROC == 3
+// Prints the displays as a line of text, when they've changed, at most every 100ms.
+// ie. 'L1 [  3 12.3] L2 [  2  9.8] Start [oo......] Bar [YYYYYYYYYYYYYYYYYYYYYYYY] Err 0'
+void TermPrint() {
+  if (!termChanged || millis() - termPrintMillis < 100) return;
+  termPrintMillis = millis();
+  termChanged = false;
+  for (byte u = 0; u < LANE_COUNT; u++) {
+    Serial.print(F("L"));
+    Serial.print(u + 1);
+    Serial.print(F(" ["));
+    for (byte i = 0; i < LED_DIGITS; i++) {
+      Serial.print(termBars[u][i]);
+      if (termDps[u][i]) Serial.print('.');
+    }
+    Serial.print(F("] "));
+  }
+  Serial.print(F("Start ["));
+  for (byte i = 0; i < 8; i++) Serial.print(termLights & bit(i) ? 'o' : '.');
+  Serial.print(F("] Bar ["));
+  Serial.write(termBar, sizeof(termBar));
+  Serial.print(F("] Err "));
+  Serial.println(coprocErrorCount);
+}
+#endif
+
+// Run as loop() on the coprocessor.
+void CoprocLoop() {
+  while (Serial.available()) CoprocRead(Serial.read());
+  unsigned long now = millis();
+  if (now - coprocTickMillis >= COPROC_CLOCK_MS) {
+    coprocTickMillis = now;
+    for (byte u = 0; u < LANE_COUNT; u++) {
+      if (!coprocClockOn[u]) continue;
+      PrintClockOn<LaneDisplay>(u, now - coprocClockStart[u], coprocClockEnd[u], coprocClockWidth[u], coprocClockPrecision[u], 0, false);
+    }
+  }
+  #if DISPLAY_COPROC == 2
+    if (marqueeDue) MarqueeDraw();
+  #else
+    TermPrint();
+  #endif
+}
+#endif
+
+
+// ******* RACE ARCHIVE ******************
+#if SD_ARCHIVE
+#if defined ( __AVR_ATmega328P__ )
+  #error "SD_ARCHIVE needs the SPI pins, which are used by the keypad and buzzer on a Nano."
+#endif
+// Every lap, fault, and state change of a race is logged to an SD card, as 8 byte records:
+// type, lane, data (2 bytes), time (4 bytes), LSB 1st. See 'archiveRecords' for what each type holds.
+// The records are gathered in a 512 byte block buffer, and the card is only ever written a whole block at a time.
+// A block is written from the top of loop(), once it doesn't have room for another loop's records,
+// so a write never lands in the middle of a lap update. The last, part filled, block is written after the race.
+// The card is used as raw blocks, through the SPI registers, so there are no file system updates between blocks.
+//
+// The 1st archive block is the race index, so a race can be found without scanning the records.
+// It starts with "RTA1", the # of races logged (2 bytes), 2 unused bytes, and the next free block (4 bytes).
+// Then there is an 8 byte entry per race, in a ring of 'archiveIndexSlots' entries, with the newest race at
+// slot (races logged - 1) % 'archiveIndexSlots': the race's 1st block (4 bytes), # of blocks (2), and race # (2).
+const uint16_t archiveBlockSize = 512;
+const byte archiveRecordSize = 8;
+const byte archiveIndexHeader = 12;
+const byte archiveIndexSlots = (archiveBlockSize - archiveIndexHeader) / 8;
+// Most records logged by one loop(), a lap or fault per lane, and a state change.
+const byte archiveLoopRecords = laneCount + 2;
+const char archiveMagic[] = "RTA1";
+byte archiveBlock[archiveBlockSize];
+uint16_t archiveFill = 0;
+// Set once the card is initialized and its index read. Cleared if a write fails.
+bool archiveReady = false;
+// Set while a race is being logged, from staging to the finish.
+bool archiveOpen = false;
+// SDHC/SDXC cards are addressed by block #, older SDSC cards by byte.
+bool sdBlockAddressing = false;
+unsigned long archiveNextBlock;
+unsigned int archiveRaceCount;
+unsigned long archiveRaceBlock;
+unsigned int archiveRaceBlocks;
+// Records that didn't fit in the block buffer, logged at the end of the race.
+unsigned int archiveDropped;
+states archiveState = Menu;
+
+byte SdSpi(byte data) {
+  SPDR = data;
+  while (!(SPSR & bit(SPIF)));
+  return SPDR;
+}
+
+// The card holds its data out LOW while it's busy programming a block.
+bool SdWaitReady(unsigned int timeoutMs) {
+  unsigned long start = millis();
+  while (SdSpi(0xFF) != 0xFF) {
+    if (millis() - start > timeoutMs) return false;
+  }
+  return true;
+}
+
+// Selects the card and sends it a command, returns its R1 response. The caller deselects the card.
+byte SdCommand(byte cmd, unsigned long arg) {
+  digitalWrite(SD_CS_PIN, LOW);
+  SdWaitReady(300);
+  SdSpi(0x40 | cmd);
+  for (int8_t shift = 24; shift >= 0; shift -= 8) SdSpi(arg >> shift);
+  // In SPI mode the CRC is only checked on CMD0 and CMD8.
+  SdSpi(cmd == 0 ? 0x95 : (cmd == 8 ? 0x87 : 0x01));
+  byte r1 = 0xFF;
+  for (byte i = 0; i < 10 && (r1 & 0x80); i++) r1 = SdSpi(0xFF);
+  return r1;
+}
+
+void SdDeselect() {
+  digitalWrite(SD_CS_PIN, HIGH);
+  // The card only releases its data out on the next clock.
+  SdSpi(0xFF);
+}
+
+// Puts the card in SPI mode, returns false if there's no card, or it doesn't respond.
+bool SdSetup() {
+  pinMode(SD_CS_PIN, OUTPUT);
+  digitalWrite(SD_CS_PIN, HIGH);
+  // SS must be an output, or the SPI can drop out of master mode.
+  pinMode(SS, OUTPUT);
+  pinMode(MOSI, OUTPUT);
+  pinMode(SCK, OUTPUT);
+  // SPI master, mode 0, at 125kHz (fosc/128) while the card is initialized.
+  SPCR = bit(SPE) | bit(MSTR) | bit(SPR1) | bit(SPR0);
+  SPSR = 0;
+  // The card needs at least 74 clocks, while deselected, to start up.
+  for (byte i = 0; i < 10; i++) SdSpi(0xFF);
+
+  byte r1;
+  unsigned long start = millis();
+  do {
+    r1 = SdCommand(0, 0);
+    SdDeselect();
+    if (millis() - start > 500) return false;
+  } while (r1 != 0x01);
+  // Only version 2 cards, which may be SDHC, know CMD8. Its reply echoes back the 0xAA check pattern.
+  bool v2 = false;
+  if (SdCommand(8, 0x1AA) == 0x01) {
+    for (byte i = 0; i < 3; i++) SdSpi(0xFF);
+    v2 = (SdSpi(0xFF) == 0xAA);
+  }
+  SdDeselect();
+  start = millis();
+  do {
+    SdCommand(55, 0);
+    SdDeselect();
+    r1 = SdCommand(41, v2 ? 0x40000000UL : 0);
+    SdDeselect();
+    if (millis() - start > 1000) return false;
+  } while (r1 != 0);
+  if (v2) {
+    // The OCR's CCS bit is set on cards addressed by block.
+    r1 = SdCommand(58, 0);
+    if (r1 == 0) {
+      sdBlockAddressing = SdSpi(0xFF) & 0x40;
+      for (byte i = 0; i < 3; i++) SdSpi(0xFF);
+    }
+    SdDeselect();
+    if (r1 != 0) return false;
+  }
+  if (!sdBlockAddressing) {
+    r1 = SdCommand(16, archiveBlockSize);
+    SdDeselect();
+    if (r1 != 0) return false;
+  }
+  // Full speed, 8MHz (fosc/2).
+  SPCR = bit(SPE) | bit(MSTR);
+  SPSR = bit(SPI2X);
+  return true;
+}
+
+bool SdReadBlock(unsigned long block, byte *data) {
+  if (SdCommand(17, sdBlockAddressing ? block : block << 9) != 0) {
+    SdDeselect();
+    return false;
+  }
+  byte token;
+  unsigned long start = millis();
+  while ((token = SdSpi(0xFF)) == 0xFF && millis() - start < 300);
+  if (token != 0xFE) {
+    SdDeselect();
+    return false;
+  }
+  for (uint16_t i = 0; i < archiveBlockSize; i++) data[i] = SdSpi(0xFF);
+  // CRC, not checked
+  SdSpi(0xFF);
+  SdSpi(0xFF);
+  SdDeselect();
+  return true;
+}
+
+// Sends a block to the card, and returns without waiting for it to be programmed.
+// That wait is taken by the next command, which is usually a block, or more, of records later.
+bool SdWriteBlock(unsigned long block, const byte *data) {
+  if (SdCommand(24, sdBlockAddressing ? block : block << 9) != 0) {
+    SdDeselect();
+    return false;
+  }
+  SdSpi(0xFE);
+  for (uint16_t i = 0; i < archiveBlockSize; i++) SdSpi(data[i]);
+  SdSpi(0xFF);
+  SdSpi(0xFF);
+  // Data response, xxx00101 is accepted.
+  bool accepted = ((SdSpi(0xFF) & 0x1F) == 0x05);
+  SdDeselect();
+  return accepted;
+}
+
+// Block buffer values are stored LSB 1st.
+void ArchivePut(uint16_t idx, unsigned long value, byte size) {
+  for (byte b = 0; b < size; b++) {
+    archiveBlock[idx + b] = value;
+    value >>= 8;
+  }
+}
+
+unsigned long ArchiveGet(uint16_t idx, byte size) {
+  unsigned long value = 0;
+  for (byte b = size; b > 0; b--) value = (value << 8) | archiveBlock[idx + b - 1];
+  return value;
+}
+
+// Finds the card and reads its race index, or starts a new index if the card hasn't been used for an archive.
+void ArchiveSetup() {
+  archiveReady = SdSetup() && SdReadBlock(SD_ARCHIVE_FIRST_BLOCK, archiveBlock);
+  if (!archiveReady) return;
+  if (memcmp(archiveBlock, archiveMagic, 4) != 0) {
+    memset(archiveBlock, 0, archiveBlockSize);
+    memcpy(archiveBlock, archiveMagic, 4);
+    ArchivePut(8, SD_ARCHIVE_FIRST_BLOCK + 1, 4);
+    archiveReady = SdWriteBlock(SD_ARCHIVE_FIRST_BLOCK, archiveBlock);
+  }
+  archiveRaceCount = ArchiveGet(4, 2);
+  archiveNextBlock = ArchiveGet(8, 4);
+}
+
+// Logs a record to the block buffer. The buffer is only written to the card by ArchiveUpdate().
+void ArchiveAppend(archiveRecords type, byte lane, unsigned int data, unsigned long time) {
+  if (!archiveOpen) return;
+  if (archiveFill + archiveRecordSize > archiveBlockSize) {
+    archiveDropped++;
+    return;
+  }
+  archiveBlock[archiveFill] = type;
+  archiveBlock[archiveFill + 1] = lane;
+  ArchivePut(archiveFill + 2, data, 2);
+  ArchivePut(archiveFill + 4, time, 4);
+  archiveFill += archiveRecordSize;
+}
+
+// Writes the block buffer to the next archive block, padded out with ArchPad records.
+void ArchiveFlush() {
+  memset(archiveBlock + archiveFill, ArchPad, archiveBlockSize - archiveFill);
+  archiveFill = 0;
+  if (!SdWriteBlock(archiveNextBlock, archiveBlock)) {
+    // Don't keep stalling the race on a card that's gone.
+    archiveReady = false;
+    archiveOpen = false;
+    return;
+  }
+  archiveRaceBlocks++;
+  archiveNextBlock++;
+  if (archiveNextBlock > SD_ARCHIVE_FIRST_BLOCK + SD_ARCHIVE_BLOCKS) archiveNextBlock = SD_ARCHIVE_FIRST_BLOCK + 1;
+}
+
+void ArchiveRaceBegin() {
+  if (!archiveReady) return;
+  archiveOpen = true;
+  archiveFill = 0;
+  archiveRaceBlock = archiveNextBlock;
+  archiveRaceBlocks = 0;
+  archiveDropped = 0;
+  ArchiveAppend(ArchRaceStart, raceType, raceLaps, raceSetTimeMs);
+}
+
+// Writes out the race's last records, and adds the race to the index.
+void ArchiveRaceEnd() {
+  if (archiveFill + archiveRecordSize > archiveBlockSize) ArchiveFlush();
+  ArchiveAppend(ArchRaceEnd, finishedCount, archiveDropped, currentTime[0]);
+  ArchiveFlush();
+  if (!archiveOpen) return;
+  archiveOpen = false;
+  // The block buffer is free until the next race, so the index is read back into it to be updated.
+  if (!SdReadBlock(SD_ARCHIVE_FIRST_BLOCK, archiveBlock)) {
+    archiveReady = false;
+    return;
+  }
+  uint16_t slot = archiveIndexHeader + (archiveRaceCount % archiveIndexSlots) * 8;
+  archiveRaceCount++;
+  ArchivePut(4, archiveRaceCount, 2);
+  ArchivePut(8, archiveNextBlock, 4);
+  ArchivePut(slot, archiveRaceBlock, 4);
+  ArchivePut(slot + 4, archiveRaceBlocks, 2);
+  ArchivePut(slot + 6, archiveRaceCount, 2);
+  archiveReady = SdWriteBlock(SD_ARCHIVE_FIRST_BLOCK, archiveBlock);
+}
+
+// Run at the top of every loop(), before any of the loop's laps are processed.
+// Logs state changes, opens and closes the race, and writes the block buffer once it's nearly full.
+void ArchiveUpdate() {
+  if (state != archiveState) {
+    // A race is logged from when it's staged, so its start faults are included.
+    if (state == Staging && !archiveOpen) ArchiveRaceBegin();
+    ArchiveAppend(ArchState, state, 0, millis());
+    archiveState = state;
+    // A race ends at its finish, or on exiting to the menus from staging.
+    if (archiveOpen && (state == Finish || state == Menu)) {
+      ArchiveRaceEnd();
+      return;
+    }
+  }
+  if (archiveOpen && archiveBlockSize - archiveFill < archiveLoopRecords * archiveRecordSize) ArchiveFlush();
+}
+#endif
+
+
+// ******* TRACK SIMULATOR ******************
+#if TRACK_SIMULATOR
+// The track simulator drives the lane sensor pins from a 1kHz Timer1 interrupt, as if cars were
+// crossing the lap sensors, so the real ISR(PCINT_VECT) and loop() code is run against a known ground truth.
+// A pin is triggered by switching it to an OUTPUT LOW, and released by returning it to INPUT_PULLUP.
+// The lane sensors must be disconnected while the simulator is running.
+//
+// Each simulated lap time is SIM_LAP_MS +/- a random SIM_LAP_JITTER_MS.
+// A jitter of 0 makes every lane cross at the same time, on every lap.
+// While not in the Race state, the cars hold their position on track, so a pause happens mid-lap.
+// At the end of each race the lap counts, and finishing places, are checked against the simulator.
+
+// Simulated crossings of each lane in the current race, counting the start crossing.
+// This should always match the lane's lapCount.
+volatile int simCrossings[laneCount + 1] = {};
+// millis() timestamp of each lane's next crossing, 0 if not yet scheduled.
+volatile unsigned long simNextMillis[laneCount + 1] = {};
+// millis() timestamp of each lane's last crossing, used to work out the true finishing order.
+volatile unsigned long simLastCrossMillis[laneCount + 1] = {};
+// micros() timestamp each lane's pin was last driven LOW, to measure the trigger latency.
+volatile unsigned long simDriveMicros[laneCount + 1] = {};
+// ms left before each lane's simulated sensor pulse is released.
+volatile byte simPulseTicks[laneCount + 1] = {};
+// Set on a pause, as the 1st crossing after a pause only restarts the interrupted lap.
+volatile bool simRestartLap[laneCount + 1] = {};
+// Set once a lane has made its 1 counted crossing after a Timed race's deadline, see FINISH_CURRENT_LAP.
+volatile bool simLapFinal[laneCount + 1] = {};
+// Seed of the xorshift random generator.
+volatile unsigned int simRandom = 1;
+// Analog button pin the simulator is pressing, read once by buttonPressed(), 255 for none.
+volatile byte simPressPin = 255;
+// state seen on the last simulator tick, and the millis() timestamp it was entered.
+volatile states simLastState = Menu;
+volatile unsigned long simStateMillis = 0;
+// Time into the Race state a SIM_SOAK test will press pause, and how long it holds it, 0 for no pause.
+volatile unsigned int simPauseAtMillis = 0;
+volatile unsigned int simPauseHoldMillis = 0;
+
+// Soak test report, totalled over every simulated race since boot or the last reset.
+unsigned int simRaces = 0;
+// Laps the controller missed, and laps it counted that were never crossed.
+unsigned int simMissedLaps = 0;
+unsigned int simExtraLaps = 0;
+// Finishing places that did not match the simulator's finishing order.
+unsigned int simWrongPlaces = 0;
+// Worst latency, in us, from a pin being driven to the lane ISR reading it.
+volatile unsigned int simMaxLatencyMicros = 0;
+#if BUS_ACCOUNTING
+// Races whose bus time was over BUS_BUDGET_RACE. Any fails the soak test, which then stops at the race's Finish.
+unsigned int simOverBudget = 0;
+// Race state ms and bus time logged before this race, so each race is checked against the budget on its own.
+unsigned long simBusMillisStart = 0;
+unsigned long simBusMicrosStart = 0;
+#endif
+
+// Returns a pseudo random number from 0 to (range - 1). Called from the Timer1 ISR.
+unsigned int SimRandom(unsigned int range){
+  simRandom ^= simRandom << 7;
+  simRandom ^= simRandom >> 9;
+  simRandom ^= simRandom << 8;
+  return (range == 0 ? 0 : simRandom % range);
+}
+
+// Returns the next simulated lap time in ms.
+// A lap can never be shorter than the debounce time, or the controller would be right to drop it.
+unsigned int SimLapTime(){
+  unsigned int lapTime = SIM_LAP_MS - SIM_LAP_JITTER_MS + SimRandom(2 * SIM_LAP_JITTER_MS + 1);
+  return (lapTime < debounceTime + 2 * SIM_PULSE_MS ? debounceTime + 2 * SIM_PULSE_MS : lapTime);
+}
+
+// Clears the simulator's ground truth for a new race. Called as each new race is reset.
+void SimResetRace(){
+  noInterrupts();
+  for (byte i = 0; i <= laneCount; i++){
+    simCrossings[i] = 0;
+    simNextMillis[i] = 0;
+    simLastCrossMillis[i] = 0;
+    simRestartLap[i] = false;
+    simLapFinal[i] = false;
+  }
+  // A soak test pauses half of its races, at a random time in the 1st 10 laps.
+  simPauseAtMillis = (SimRandom(2) ? 500 + SimRandom(SIM_LAP_MS * 10) : 0);
+  simPauseHoldMillis = 500 + SimRandom(3000);
+  interrupts();
+  #if BUS_ACCOUNTING
+    simBusMillisStart = busStateMillis[Race];
+    simBusMicrosStart = busI2cMicros[Race] + busLedMicros[Race];
+  #endif
+}
+
+// Called by the lane ISR on the leading edge of each lane trigger.
+void SimLogLatency(byte lane, unsigned long logMicros){
+  unsigned long latency = logMicros - simDriveMicros[lane];
+  if (latency > simMaxLatencyMicros) simMaxLatencyMicros = (latency > 0xFFFF ? 0xFFFF : latency);
+}
+
+// Seeds the simulator's random generator. The simulator is run from the 1kHz Timer1 tick.
+void SimSetup(){
+  simRandom = micros() | 1;
+}
+
+// Runs the simulated cars, and for a SIM_SOAK test, the buttons, once every ms.
+void SimTick(){
+  unsigned long now = millis();
+  if (state != simLastState) {
+    simLastState = state;
+    simStateMillis = now;
+    if (state == Paused) {
+      for (byte i = 1; i <= laneCount; i++) simRestartLap[i] = (simCrossings[i] > 0);
+    }
+  }
+  for (byte i = 1; i <= laneCount; i++){
+    // Release the sensor pulse of the last crossing.
+    if (simPulseTicks[i] > 0 && --simPulseTicks[i] == 0) pinMode(lanes[i][0], INPUT_PULLUP);
+    if (laneEnableStatus[i] == Off || laneEnableStatus[i] == Finished) continue;
+    if (DragRace() && i > 2) continue;
+    // Outside of a race, the cars hold their position on track.
+    if (state != Race) {
+      if (simNextMillis[i] != 0) simNextMillis[i]++;
+      continue;
+    }
+    // The 1st crossing is the racer's reaction to the green.
+    if (simNextMillis[i] == 0) simNextMillis[i] = now + SimRandom(SIM_REACTION_MS);
+    if ((long)(now - simNextMillis[i]) < 0) continue;
+    // Once a Timed race's time is up, the controller doesn't count a crossing, other than the one that finishes
+    // a racer's current lap with FINISH_CURRENT_LAP, so the car is pulled off the track.
+    if (raceDeadlineOn && (long)(now - raceDeadlineMillis) >= 0) {
+      if (!FINISH_CURRENT_LAP || simLapFinal[i] || simRestartLap[i]) continue;
+      simLapFinal[i] = true;
+    }
+    simNextMillis[i] += SimLapTime();
+    if (simRestartLap[i]) simRestartLap[i] = false;
+    else simCrossings[i]++;
+    simLastCrossMillis[i] = now;
+    // With a single drag trigger there is no start sensor to cross.
+    if (DragRace() && SINGLE_DRAG_TRIGGER && simCrossings[i] == 1) continue;
+    simDriveMicros[i] = micros();
+    pinMode(lanes[i][0], OUTPUT);
+    digitalWrite(lanes[i][0], LOW);
+    simPulseTicks[i] = SIM_PULSE_MS;
+  }
+  // A soak test presses the buttons to keep races running back to back.
+  if (SIM_SOAK && simPressPin == 255) {
+    unsigned long inState = now - simStateMillis;
+    switch (state) {
+      case Staging: case Fault:
+        if (inState > 2000) simPressPin = startButtonPin;
+      break;
+      case Finish:
+        #if BUS_ACCOUNTING
+          // A race over the bus budget fails the soak, so it's left on its Finish.
+          if (simOverBudget > 0) break;
+        #endif
+        if (inState > 2000) simPressPin = startButtonPin;
+      break;
+      case Race:
+        if (simPauseAtMillis != 0 && inState > simPauseAtMillis) {
+          simPressPin = pauseStopPin;
+          simPauseAtMillis = 0;
+        }
+      break;
+      case Paused:
+        if (inState > simPauseHoldMillis) simPressPin = startButtonPin;
+      break;
+      default:
+      break;
+    }
+  }
+}
+#endif
+
+
+// // Function returns true if the bit at the, 'pos', postion of a byte is 1,
 // // otherwise it returns false.
 // // In a Byte, position is from right to left, the far right bit is considered bit 1 at idx0.
 // // EX. If function parameters are pos = 3 and b = 0x11111000
@@ -1350,21 +3643,60 @@ ISR (PCINT_VECT) {
 
 // Generic function to check if an analog button is pressed
 bool buttonPressed(uint8_t analogPin) {
-  // if below analog trigger threshold AND not within debounce time
-  unsigned long tempTime = millis();
-  if ((analogRead(analogPin) < 100) && ((tempTime - buttonDebounceMillis) > debounceTime)){
-    // Reset debounce timestatmp
+  #if TRACK_SIMULATOR
+    // A press by the simulator is read once, as if the button had been debounced.
+    if (simPressPin == analogPin) {
+      simPressPin = 255;
+      return true;
+    }
+  #endif
+  // The press edge is set by the ADC interrupt, once per debounced press.
+  byte idx = (analogPin == startButtonPin ? 1 : 0);
+  if (buttonEdge[idx]) {
+    buttonEdge[idx] = false;
+    idleInputMillis = millis();
     Beep();
     // Serial.println("pressed");
-    // Serial.println(tempTime - buttonDebounceMillis);
-    buttonDebounceMillis = tempTime;
     return true;
   }
-  // Serial.println("button pressed");
-  // Serial.println(analogRead(analogPin));
   return false;
 }
 
+// Sets the ADC to convert on every Timer0 overflow (~1ms), with an interrupt on each result.
+// The ADC interrupt alternates between the pause and start button pins,
+// so each button is sampled about every 2ms without loop() waiting on an analogRead().
+// Both buttons must be on ADC channels 0-7 (A0-A7).
+void ButtonSamplerSetup(){
+  noInterrupts();
+  adcButtonIdx = 0;
+  // AVcc reference, left adjusted result so the top 8 bits can be read from ADCH
+  ADMUX = bit(REFS0) | bit(ADLAR) | (pauseStopPin - PIN_A0);
+  // auto trigger source, Timer0 overflow
+  ADCSRB = bit(ADTS2);
+  // enable, auto trigger, interrupt, and a /128 clock prescaler
+  ADCSRA = bit(ADEN) | bit(ADATE) | bit(ADIE) | bit(ADPS2) | bit(ADPS1) | bit(ADPS0);
+  interrupts();
+}
+
+// ADC conversion complete interrupt, updates the state of the button just sampled.
+ISR (ADC_vect) {
+  byte level = ADCH;
+  byte idx = adcButtonIdx;
+  // Switch to the other button, the next conversion won't start until the next Timer0 overflow.
+  adcButtonIdx = !idx;
+  ADMUX = bit(REFS0) | bit(ADLAR) | ((adcButtonIdx ? startButtonPin : pauseStopPin) - PIN_A0);
+  if (!buttonDown[idx] && level < buttonPressLevel) {
+    buttonDown[idx] = true;
+    unsigned long now = millis();
+    if (now - buttonDebounceMillis[idx] > debounceTime) {
+      buttonEdge[idx] = true;
+      buttonDebounceMillis[idx] = now;
+    }
+  } else if (buttonDown[idx] && level > buttonReleaseLevel) {
+    buttonDown[idx] = false;
+  }
+}
+
 
 // This function compares the input race time with current fastest list.
 // If the new lap time is faster than any existing time, it takes its place,
@@ -1423,13 +3755,16 @@ void PrintLeaderBoard(bool withLeaders = true){
   // Write static text to main LCD for live race screen
   // lcd.clear();
   lcd.setCursor(15, 0);
-  lcd.print(RESULTS_TOP_TEXT_BEST);
+  lcd.print(LIVE_GAPS ? (gapShowInterval ? LIVE_INT_TEXT : LIVE_GAP_TEXT) : RESULTS_TOP_TEXT_BEST);
   // Draw vertical bars seperating leader list from best lap.
   for(byte row = 0; row <= LCD_ROWS; row++){
     lcd.setCursor(12, row);
     lcd.print("|");
   }
-  if(withLeaders) UpdateLiveRaceLCD();
+  if(withLeaders) {
+    UpdateLeaderBoard();
+    UpdateLiveRaceLCD();
+  }
 }
 
 
@@ -1453,7 +3788,7 @@ void PrintResultsList(unsigned long times[], unsigned int laps[], int listSize)
       // then print RACER NAME
       // if idx = 0 then it's the top results and has racer names with the lap times.
       if(resultsMenuIdx == 0){
-        PrintText(Racers[topFastestRacers[resultsRowIdx + i]], lcdDisp, 19, 6, true, i + 1, false);
+        PrintText(RacerName(topFastestRacers[resultsRowIdx + i]), lcdDisp, 19, 6, true, i + 1, false);
       }
     } else {
       // we want to set the index back one so it doesn't keep scrolling in empty space
@@ -1495,7 +3830,7 @@ void UpdateResultsMenu(bool full = true) {
         // else print the racer name
         else {
           // print total laps completed
-          PrintText(Racers[laneRacer[resultsMenuIdx]], lcdDisp, 16, 14, false, 0);
+          PrintText(RacerName(laneRacer[resultsMenuIdx]), lcdDisp, 16, 14, false, 0);
           // Print label for and total # of laps completed
           PrintText(RESULTS_TOTAL_LBLB, lcdDisp, 19, 6, true, 2, false);
           // int lapCountTemp = ((lapCount[resultsMenuIdx] == 0) ? 0 : (lapCount[resultsMenuIdx]-1));
@@ -1527,12 +3862,266 @@ void UpdateResultsMenu(bool full = true) {
       PrintText(RESULTS_FINISH_LBL, lcdDisp, 19, 20, false, 0);
       PrintLeaderBoard(true);
     }
+    break;
+    // When a tournament is running, the standings follow the finish leader board.
+    case laneCount + 2:{
+      lcd.clear();
+      PrintText(RESULTS_STANDINGS_LBL, lcdDisp, 19, 20, false, 0);
+      PrintStandings();
+    }
+    break;
+    #if SEASON_STANDINGS
+    // The season standings swap between points and lap times, like the racer name and # of the racer pages.
+    case resultsSeasonIdx:{
+      if (full) lcd.clear();
+      PrintSeason(resultsRowIdx, titleA);
+    }
+    break;
+    #endif
     default:
     break;
   }
 } // END UpdateResultsMenu()
 
 
+// Adds a time sample to a log2 bucketed latency histogram. Called from the ISR so keep it short.
+// When a bucket's counter fills, every bucket is halved, so the histogram keeps its shape.
+void LogLatency(byte hist[], unsigned long us, const byte baseShift){
+  byte bucket = 0;
+  us = us >> baseShift;
+  while (us > 0 && bucket < latencyBuckets - 1) {
+    us = us >> 1;
+    bucket++;
+  }
+  if (hist[bucket] == 255) {
+    for (byte i = 0; i < latencyBuckets; i++) hist[i] = hist[i] >> 1;
+  }
+  hist[bucket]++;
+}
+
+// Clears the ISR and loop() latency histograms.
+void ResetLatencyStats(){
+  noInterrupts();
+  memset(isrLatencyHist, 0, sizeof(isrLatencyHist));
+  interrupts();
+  memset(loopLatencyHist, 0, sizeof(loopLatencyHist));
+}
+
+#if BUS_ACCOUNTING
+// Run at the top of every loop(), adds the bus traffic since the last loop() to the state it ran in.
+// An I2C byte is 9 clocks, and a start and stop add ~2 more. The LED bytes are bit banged, BUS_LED_BYTE_US each.
+void LogBus(){
+  unsigned int i2cBytes = 0;
+  unsigned int i2cStarts = 0;
+  #if I2C_ASYNC
+    noInterrupts();
+    i2cBytes = twiBusBytes;
+    i2cStarts = twiBusStarts;
+    twiBusBytes = 0;
+    twiBusStarts = 0;
+    interrupts();
+  #endif
+  unsigned long now = millis();
+  busStateMillis[loopState] += now - busLogMillis;
+  busLogMillis = now;
+  busI2cBytes[loopState] += i2cBytes;
+  busI2cStarts[loopState] += i2cStarts;
+  busI2cMicros[loopState] += ((unsigned long)i2cBytes * 9 + i2cStarts * 2) * 1000 / (I2C_CLOCK / 1000);
+  busLedBytes[loopState] += ledBusBytes;
+  busLedMicros[loopState] += ledBusBytes * BUS_LED_BYTE_US;
+  ledBusBytes = 0;
+}
+
+// Estimated ms of bus time per second spent in state 's', the share of its time spent on the bus, in 1/1000s.
+unsigned int BusMillisPerSec(byte s, const unsigned long busMicros[]){
+  if (busStateMillis[s] == 0) return 0;
+  return busMicros[s] / busStateMillis[s];
+}
+
+// true if the Race state's bus time is over its BUS_BUDGET_RACE. 0 is no budget.
+bool BusOverBudget(){
+  return (BUS_BUDGET_RACE > 0 && BusMillisPerSec(Race, busI2cMicros) + BusMillisPerSec(Race, busLedMicros) > BUS_BUDGET_RACE);
+}
+
+void ResetBusStats(){
+  memset(busStateMillis, 0, sizeof(busStateMillis));
+  memset(busI2cBytes, 0, sizeof(busI2cBytes));
+  memset(busI2cStarts, 0, sizeof(busI2cStarts));
+  memset(busLedBytes, 0, sizeof(busLedBytes));
+  memset(busI2cMicros, 0, sizeof(busI2cMicros));
+  memset(busLedMicros, 0, sizeof(busLedMicros));
+  #if TRACK_SIMULATOR
+    simBusMillisStart = 0;
+    simBusMicrosStart = 0;
+  #endif
+}
+
+// Prints the Race state's bus time, against its budget, to the LCD.
+void PrintBusReport(){
+  lcd.print(F("Bus Race       C|Nxt"));
+  lcd.setCursor(0, 1);
+  #if I2C_ASYNC
+    lcd.print(F("I2C           ms/s"));
+    PrintNumbers(BusMillisPerSec(Race, busI2cMicros), 4, 13, lcdDisp, false, 1);
+  #else
+    lcd.print(F("I2C  needs I2C_ASYNC"));
+  #endif
+  lcd.setCursor(0, 2);
+  lcd.print(F("LED           ms/s"));
+  PrintNumbers(BusMillisPerSec(Race, busLedMicros), 4, 13, lcdDisp, false, 2);
+  lcd.setCursor(0, 3);
+  lcd.print(F("Budget"));
+  if (BUS_BUDGET_RACE > 0) {
+    PrintNumbers(BUS_BUDGET_RACE, 4, 13, lcdDisp, false, 3);
+    lcd.setCursor(15, 3);
+    lcd.print(BusOverBudget() ? F("OVER") : F("OK"));
+  }
+}
+#endif
+
+// Clears the lane sensor pulse width stats and zero-read count.
+void ResetSensorStats(){
+  noInterrupts();
+  for (byte i = 0; i <= laneCount; i++){
+    pulseMinMicros[i] = 0;
+    pulseMaxMicros[i] = 0;
+    pulseSumMicros[i] = 0;
+    pulseCount[i] = 0;
+    zeroReadCount[i] = 0;
+  }
+  interrupts();
+}
+
+// Writes the ISR and loop() latency histograms to the serial port as CSV rows.
+// Each row is the histogram name, its 1st bucket's upper limit in us, then the bucket counts.
+// The loop() rows are named by their state.
+// 'Serial' is only referenced with DIAGNOSTICS_SERIAL, as linked controllers have their own serial interrupts.
+void SerialDumpLatency(){
+  #if DIAGNOSTICS_SERIAL
+  byte hist[latencyBuckets];
+  noInterrupts();
+  memcpy(hist, isrLatencyHist, sizeof(hist));
+  interrupts();
+  Serial.print(F("isr,"));
+  Serial.print(1 << ISR_HIST_BASE_SHIFT);
+  for (byte i = 0; i < latencyBuckets; i++){
+    Serial.print(',');
+    Serial.print(hist[i]);
+  }
+  Serial.println();
+  for (byte s = 0; s <= PreFault; s++){
+    Serial.print(F("loop "));
+    Serial.print((const __FlashStringHelper *)StateNames[s]);
+    Serial.print(',');
+    Serial.print(1 << LOOP_HIST_BASE_SHIFT);
+    for (byte i = 0; i < latencyBuckets; i++){
+      Serial.print(',');
+      Serial.print(loopLatencyHist[s][i]);
+    }
+    Serial.println();
+  }
+  #if BUS_ACCOUNTING
+    // Bus rows: state, ms in state, I2C bytes, I2C transactions, LED bytes, then I2C and LED bus ms per second.
+    for (byte s = 0; s <= PreFault; s++){
+      Serial.print(F("bus "));
+      Serial.print((const __FlashStringHelper *)StateNames[s]);
+      Serial.print(',');
+      Serial.print(busStateMillis[s]);
+      Serial.print(',');
+      Serial.print(busI2cBytes[s]);
+      Serial.print(',');
+      Serial.print(busI2cStarts[s]);
+      Serial.print(',');
+      Serial.print(busLedBytes[s]);
+      Serial.print(',');
+      Serial.print(BusMillisPerSec(s, busI2cMicros));
+      Serial.print(',');
+      Serial.println(BusMillisPerSec(s, busLedMicros));
+    }
+  #endif
+  #endif
+}
+
+// Prints a latency histogram's 8 bucket counts to LCD rows 1-2, 4 per row.
+// Row 3 notes the range of the 1st bucket, each bucket after it doubles the range.
+void PrintLatencyHist(const byte hist[], const byte baseShift){
+  for (byte i = 0; i < latencyBuckets; i++){
+    PrintNumbers(hist[i], 3, (i % 4) * 5 + 3, lcdDisp, false, 1 + i / 4);
+  }
+  lcd.setCursor(0, 3);
+  lcd.print(F("1st <     us,then x2"));
+  PrintNumbers(1 << baseShift, 5, 9, lcdDisp, false, 3);
+}
+
+// Prints the page of the Diagnostics Menu given by diagMenuIdx.
+// Pages 0 to laneCount-1 show the sensor pulse widths of lanes 1 to laneCount.
+// Page laneCount shows the ISR latency histogram, followed by a page for the loop() latency of each state.
+// Then the Race state's bus time, if BUS_ACCOUNTING is on, and the track simulator's soak test report, if it's built in.
+void UpdateDiagnosticsMenu(){
+  lcd.clear();
+  #if BUS_ACCOUNTING
+    if (diagMenuIdx == diagBusPage) {
+      PrintBusReport();
+      return;
+    }
+  #endif
+  #if TRACK_SIMULATOR
+    if (diagMenuIdx == diagSimPage) {
+      PrintSimReport();
+      return;
+    }
+  #endif
+  #if LINK_NODE == 1
+    if (diagMenuIdx == diagLinkPage) {
+      PrintLinkReport();
+      return;
+    }
+  #endif
+  if (diagMenuIdx >= laneCount) {
+    byte histIdx = diagMenuIdx - laneCount;
+    if (histIdx == 0) {
+      lcd.print(F("ISR Time       C|Nxt"));
+      byte hist[latencyBuckets];
+      noInterrupts();
+      memcpy(hist, isrLatencyHist, sizeof(hist));
+      interrupts();
+      PrintLatencyHist(hist, ISR_HIST_BASE_SHIFT);
+    } else {
+      lcd.print(F("Loop"));
+      lcd.setCursor(5, 0);
+      lcd.print((const __FlashStringHelper *)StateNames[histIdx - 1]);
+      lcd.setCursor(15, 0);
+      lcd.print(F("C|Nxt"));
+      PrintLatencyHist(loopLatencyHist[histIdx - 1], LOOP_HIST_BASE_SHIFT);
+    }
+    return;
+  }
+  byte lane = diagMenuIdx + 1;
+  // Snapshot the ISR stats so a trigger can't change them part way through printing.
+  noInterrupts();
+  unsigned int minW = pulseMinMicros[lane];
+  unsigned int maxW = pulseMaxMicros[lane];
+  unsigned long sumW = pulseSumMicros[lane];
+  unsigned int count = pulseCount[lane];
+  unsigned int zeros = zeroReadCount[lane];
+  unsigned int unknownZeros = zeroReadCount[0];
+  interrupts();
+  lcd.print(F("Lane   Sensor  C|Nxt"));
+  PrintNumbers(lane, 1, 5, lcdDisp, false, 0);
+  lcd.setCursor(0, 1);
+  lcd.print(F("  Min   Avg   Max us"));
+  PrintNumbers(minW, 5, 4, lcdDisp, false, 2);
+  PrintNumbers(count > 0 ? sumW / count : 0, 5, 10, lcdDisp, false, 2);
+  PrintNumbers(maxW, 5, 16, lcdDisp, false, 2);
+  lcd.setCursor(0, 3);
+  // Zeros that couldn't be put down to 1 lane are shown as '?'.
+  lcd.print(F("N:      Z:     ?:"));
+  PrintNumbers(count, 5, 6, lcdDisp, false, 3);
+  PrintNumbers(zeros > 9999 ? 9999 : zeros, 4, 13, lcdDisp, false, 3);
+  PrintNumbers(unknownZeros > 999 ? 999 : unknownZeros, 3, 19, lcdDisp, false, 3);
+}
+
+
 // col0 is number of laps, col1 is the lane/racer #
 // Even though only 3 places are displayed, the leader board data table,
 // should contain all of the lanes in order.
@@ -1540,9 +4129,69 @@ int leaderBoard[laneCount][2] = {};
 unsigned long overallFastestTime = 99999999;
 byte overallFastestRacer = 5;
 
-// Function to calculate and update to main display with the current leader board.
-// This function is determining the current place of all racers.
-void UpdateLiveRaceLCD(){
+// Updates a lane's gap to the leader, from the timestamp of the lap it just completed.
+void UpdateGap(byte lane){
+  int laps = lapCount[lane] - 1;
+  byte lapIdx = laps % lapMillisQSize;
+  unsigned long crossed = lastXMillis[lane][lapIdx];
+  if (laps > gapLeadLaps) {
+    // The 1st lane to complete a lap is the leader.
+    gapLeadLaps = laps;
+    gapLeadLane = lane;
+    gapLeadMillis[lapIdx] = crossed;
+    gapMillis[lane] = 0;
+    gapLapsDown[lane] = 0;
+    return;
+  }
+  gapLapsDown[lane] = gapLeadLaps - laps;
+  // Only the leader's last lapMillisQSize crossings are kept, further back the gap is only shown in laps.
+  if (gapLapsDown[lane] >= lapMillisQSize) return;
+  if (laps == gapLeadLaps && crossed < gapLeadMillis[lapIdx]) {
+    // Lanes crossing close together can be processed out of order, this lane was actually 1st across.
+    gapMillis[gapLeadLane] = gapLeadMillis[lapIdx] - crossed;
+    gapLeadMillis[lapIdx] = crossed;
+    gapLeadLane = lane;
+    gapMillis[lane] = 0;
+    return;
+  }
+  gapMillis[lane] = (crossed > gapLeadMillis[lapIdx] ? crossed - gapLeadMillis[lapIdx] : 0);
+}
+
+// Prints the gap, or interval, of each leader board place, in the right hand column of the live leader board.
+// A lane that's a lap or more down on the lane it's compared to shows '+N L' instead of a time.
+void PrintLiveGaps(){
+  PrintText(gapShowInterval ? LIVE_INT_TEXT : LIVE_GAP_TEXT, lcdDisp, 19, 5, false, 0);
+  for(byte k = 1; k <= (enabledLaneCount<3?enabledLaneCount:3); k++){
+    byte lane = leaderBoard[k-1][1];
+    PrintSpanOfChars(lcdDisp, k, 13, 19);
+    if (leaderBoard[k-1][0] == 0) continue;
+    if (k == 1) {
+      PrintText(LIVE_LEAD_TEXT, lcdDisp, 19, 6, false, k, false);
+      continue;
+    }
+    byte ahead = (gapShowInterval ? leaderBoard[k-2][1] : gapLeadLane);
+    byte lapsDown = gapLapsDown[lane] - (gapShowInterval ? gapLapsDown[ahead] : 0);
+    if (gapLapsDown[lane] > (gapShowInterval ? gapLapsDown[ahead] : 0)) {
+      lcd.setCursor(14, k);
+      lcd.print('+');
+      lcd.print(lapsDown);
+      lcd.print(F(" L"));
+    } else {
+      unsigned long gap = gapMillis[lane];
+      if (gapShowInterval) gap = (gap > gapMillis[ahead] ? gap - gapMillis[ahead] : 0);
+      lcd.setCursor(13, k);
+      lcd.print('+');
+      PrintClock(gap, 19, 6, 3, lcdDisp, k);
+    }
+  }
+}
+
+// Rebuilds the live leader board, 'leaderBoard', from each racer's completed laps.
+void UpdateLeaderBoard(){
+  if (FINISH_CURRENT_LAP && raceTimeUp) {
+    RankTimedFinish();
+    return;
+  }
   // Clear table to be rebuilt
   memset(leaderBoard, 0, sizeof(leaderBoard));
   // for (byte a=0; a < laneCount; a++) {
@@ -1642,6 +4291,77 @@ void UpdateLiveRaceLCD(){
         //   Serial.println(Racers[leaderBoard[k][1]]);
         // }
 
+  // Finished racers are ahead of those still racing, and placed among themselves by their final crossing.
+  for (byte k = 1; k < enabledLaneCount; k++) {
+    byte place = k;
+    int laps = leaderBoard[k][0];
+    int lane = leaderBoard[k][1];
+    if (finishPlace[lane] == 0) continue;
+    while (place > 0 && (finishPlace[leaderBoard[place - 1][1]] == 0 || finishPlace[leaderBoard[place - 1][1]] > finishPlace[lane])) {
+      leaderBoard[place][0] = leaderBoard[place - 1][0];
+      leaderBoard[place][1] = leaderBoard[place - 1][1];
+      place--;
+    }
+    leaderBoard[place][0] = laps;
+    leaderBoard[place][1] = lane;
+  }
+} // END UpdateLeaderBoard()
+
+
+// Returns true once a Timed race, that's run out of time, has every lap it will count.
+// With FINISH_CURRENT_LAP, that's once each racer has finished the lap they were on, or FINISH_LAP_TIMEOUT has passed.
+bool TimedLapsDone(){
+  if (LapsPending()) return false;
+  if (!FINISH_CURRENT_LAP || curMillis - raceDeadlineMillis > FINISH_LAP_TIMEOUT) return true;
+  for (byte i = 1; i <= laneCount; i++) {
+    if (laneEnableStatus[i] == Active && !lapFinal[i]) return false;
+  }
+  return true;
+}
+
+// Laps a racer had done when a Timed race's clock ran out, in 1000ths of a lap, see FINISH_CURRENT_LAP.
+// The lap they were on is counted as the part of it done by the deadline, from the times it started and finished.
+// If they didn't finish it, it isn't counted.
+unsigned long TimedLapScore(byte lane){
+  if (lapCount[lane] < 1) return 0;
+  unsigned long laps = lapCount[lane] - 1;
+  if (!lapFinal[lane]) return laps * 1000;
+  unsigned long lapStart = lastXMillis[lane][(lapCount[lane] - 2) % lapMillisQSize];
+  unsigned long lapTime = lastXMillis[lane][(lapCount[lane] - 1) % lapMillisQSize] - lapStart;
+  return (laps - 1) * 1000 + (lapTime > 0 ? (raceDeadlineMillis - lapStart) * 1000 / lapTime : 0);
+}
+
+// Places the leader board of a Timed race, that's run out of time, by TimedLapScore().
+// Racers on the same score are placed by who finished their last lap first.
+// The laps shown still include the lap finished after the deadline.
+void RankTimedFinish(){
+  memset(leaderBoard, 0, sizeof(leaderBoard));
+  unsigned long scores[laneCount];
+  unsigned long crossed[laneCount];
+  byte placed = 0;
+  for (byte lane = 1; lane <= laneCount; lane++) {
+    if (laneEnableStatus[lane] == 0) continue;
+    unsigned long score = TimedLapScore(lane);
+    unsigned long cross = (lapCount[lane] > 0 ? lastXMillis[lane][(lapCount[lane] - 1) % lapMillisQSize] : 0);
+    byte place = placed;
+    while (place > 0 && (score > scores[place - 1] || (score == scores[place - 1] && cross < crossed[place - 1]))) {
+      scores[place] = scores[place - 1];
+      crossed[place] = crossed[place - 1];
+      leaderBoard[place][0] = leaderBoard[place - 1][0];
+      leaderBoard[place][1] = leaderBoard[place - 1][1];
+      place--;
+    }
+    scores[place] = score;
+    crossed[place] = cross;
+    leaderBoard[place][0] = (lapCount[lane] > 0 ? lapCount[lane] - 1 : 0);
+    leaderBoard[place][1] = lane;
+    placed++;
+  }
+}
+
+
+// Draws the live leader board, and the fastest lap, or the gaps, to the LCD.
+void UpdateLiveRaceLCD(){
   // Print the leaderboard array to the LCD
   // Even though the places list is as long as there are lanes,
   // we only have 3 lines on the screen, so limit this loop to 3.
@@ -1660,13 +4380,18 @@ void UpdateLiveRaceLCD(){
       PrintNumbers(leaderBoard[k-1][0], 3, 4, lcdDisp, true, k);
       // Print racer's name to LCD
       // PrintText(Racers[leaderBoard[k-1][1]], lcdDisp, 11, 6, false, k);
-      PrintText(Racers[laneRacer[leaderBoard[k-1][1]]], lcdDisp, 11, 6, false, k);
+      PrintText(RacerName(laneRacer[leaderBoard[k-1][1]]), lcdDisp, 11, 6, false, k);
     }
   }
+  // The right hand column shows either the live gaps, or the fastest overall lap time, lap, and racer who achieved it.
+  if (LIVE_GAPS) {
+    PrintLiveGaps();
+    return;
+  }
   // Update fastest overall lap time, lap, and racer who achieved it
   PrintClock(overallFastestTime, 19, 6, 3, lcdDisp, 1, true);
   // PrintText(Racers[overallFastestRacer], lcdDisp, 19, 6, false, 3);
-  PrintText(Racers[laneRacer[overallFastestRacer]], lcdDisp, 19, 6, false, 2);
+  PrintText(RacerName(laneRacer[overallFastestRacer]), lcdDisp, 19, 6, false, 2);
   PrintText(RESULTS_TOP_TEXT_LAP, lcdDisp, 19, 6, false, 3);
   PrintNumbers(fastestLaps[overallFastestRacer][0], 3, 19, lcdDisp, false, 3);
   
@@ -1674,21 +4399,593 @@ void UpdateLiveRaceLCD(){
 
 
 
-void ResetRaceVars(){
-  // Reset lap count and lap flash status for all lanes/racers to 0.
-  for (byte i = 1; i <= laneCount; i++) {
-    winner = false;
-    lapCount[i] = 0;
-    flashStatus[i] = 0;
-    startMillis[i] = 0;
-    currentTime[i] = 0;
-    if(laneEnableStatus[i] > 0) laneEnableStatus[i] = StandBy;
+void ResetRaceVars(){
+  // Reset lap count and lap flash status for all lanes/racers to 0.
+  for (byte i = 1; i <= laneCount; i++) {
+    dragWinLights = 0;
+    lapCount[i] = 0;
+    flashStatus[i] = 0;
+    flashHold[i] = false;
+    startMillis[i] = 0;
+    currentTime[i] = 0;
+    if(laneEnableStatus[i] > 0) laneEnableStatus[i] = StandBy;
+  }
+  InitializeRacerArrays();
+  #if BUILD_DRAG
+    memset((void*)dragMicros, 0, sizeof(dragMicros));
+    memset((void*)dragRedLightMicros, 0, sizeof(dragRedLightMicros));
+  #endif
+  #if TRACK_SIMULATOR
+    SimResetRace();
+  #endif
+  finishedCount = 0;
+  overallFastestTime = 99999;
+  overallFastestRacer = 0;
+  ClearRaceEvents();
+  memset(finishPlace, 0, sizeof(finishPlace));
+  memset(finishTie, 0, sizeof(finishTie));
+  raceDeadlineOn = false;
+  raceTimeUp = false;
+  memset((void*)lapFinal, 0, sizeof(lapFinal));
+}
+
+
+// ******* TRACK SIMULATOR REPORT ******************
+#if TRACK_SIMULATOR
+// Returns true if lane a is truly ahead of lane b, by the simulator's ground truth.
+// More crossings is ahead, and on the same crossings, the earlier last crossing is ahead.
+bool SimAhead(byte a, byte b){
+  if (simCrossings[a] != simCrossings[b]) return simCrossings[a] > simCrossings[b];
+  return simLastCrossMillis[a] < simLastCrossMillis[b];
+}
+
+// Checks the finished race's lap counts and finishing places against the simulator's ground truth,
+// and adds the errors to the soak test report. Must be run before the Finish state resets the lanes.
+void SimCheckRace(){
+  // Lanes in the controller's finishing order.
+  byte placed[laneCount];
+  byte placedCount = 0;
+  if (DragRace()) {
+    for (byte i = 1; i <= 2; i++) {
+      if (laneEnableStatus[i] != Off) placed[placedCount++] = i;
+    }
+    if (placedCount == 2 && dragTotal[2] < dragTotal[1]) {
+      placed[0] = 2;
+      placed[1] = 1;
+    }
+  } else {
+    for (byte place = 0; place < enabledLaneCount; place++){
+      if (leaderBoard[place][1] != 0) placed[placedCount++] = leaderBoard[place][1];
+    }
+  }
+  noInterrupts();
+  for (byte place = 0; place < placedCount; place++){
+    byte lane = placed[place];
+    if (simCrossings[lane] > lapCount[lane]) simMissedLaps += simCrossings[lane] - lapCount[lane];
+    if (lapCount[lane] > simCrossings[lane]) simExtraLaps += lapCount[lane] - simCrossings[lane];
+    // A place is wrong if any lane placed behind it was truly ahead of it.
+    for (byte behind = place + 1; behind < placedCount; behind++){
+      if (SimAhead(placed[behind], lane)) {
+        simWrongPlaces++;
+        break;
+      }
+    }
+  }
+  interrupts();
+  simRaces++;
+  #if BUS_ACCOUNTING
+    // Estimated bus ms per second of this race's Race state.
+    unsigned long raceMillis = busStateMillis[Race] - simBusMillisStart;
+    unsigned int raceBus = (raceMillis == 0 ? 0 : (busI2cMicros[Race] + busLedMicros[Race] - simBusMicrosStart) / raceMillis);
+    bool overBudget = (BUS_BUDGET_RACE > 0 && raceBus > BUS_BUDGET_RACE);
+    if (overBudget) simOverBudget++;
+  #endif
+  #if DIAGNOSTICS_SERIAL
+    Serial.print(F("sim,"));
+    Serial.print(simRaces);
+    Serial.print(',');
+    Serial.print(simMissedLaps);
+    Serial.print(',');
+    Serial.print(simExtraLaps);
+    Serial.print(',');
+    Serial.print(simWrongPlaces);
+    Serial.print(',');
+    #if BUS_ACCOUNTING
+      Serial.print(simMaxLatencyMicros);
+      Serial.print(',');
+      Serial.print(raceBus);
+      Serial.print(',');
+      Serial.println(overBudget ? F("OVER") : F("OK"));
+    #else
+      Serial.println(simMaxLatencyMicros);
+    #endif
+  #endif
+}
+
+// Clears the soak test report.
+void SimResetReport(){
+  simRaces = 0;
+  simMissedLaps = 0;
+  simExtraLaps = 0;
+  simWrongPlaces = 0;
+  simMaxLatencyMicros = 0;
+  #if BUS_ACCOUNTING
+    simOverBudget = 0;
+  #endif
+}
+
+// Prints the soak test report to the LCD.
+void PrintSimReport(){
+  lcd.print(F("Simulator      C|Nxt"));
+  lcd.setCursor(0, 1);
+  lcd.print(F("Race       Miss"));
+  PrintNumbers(simRaces, 5, 9, lcdDisp, false, 1);
+  PrintNumbers(simMissedLaps > 9999 ? 9999 : simMissedLaps, 4, 19, lcdDisp, false, 1);
+  lcd.setCursor(0, 2);
+  lcd.print(F("Xtra       Plce"));
+  PrintNumbers(simExtraLaps, 5, 9, lcdDisp, false, 2);
+  PrintNumbers(simWrongPlaces > 9999 ? 9999 : simWrongPlaces, 4, 19, lcdDisp, false, 2);
+  lcd.setCursor(0, 3);
+  #if BUS_ACCOUNTING
+    lcd.print(F("Lat us     Over"));
+    PrintNumbers(simMaxLatencyMicros, 5, 9, lcdDisp, false, 3);
+    PrintNumbers(simOverBudget > 9999 ? 9999 : simOverBudget, 4, 19, lcdDisp, false, 3);
+  #else
+    lcd.print(F("Max Latency us"));
+    PrintNumbers(simMaxLatencyMicros, 5, 19, lcdDisp, false, 3);
+  #endif
+}
+#endif
+
+// ******* DRAG TIMING FUNCTIONS ******************
+// Works out the timing slip of each drag lane from the us timestamps logged by the ISR.
+// Reaction time (RT) is green light to start line, elapsed time (ET) is start line to finish line.
+// Their total, green light to finish line, decides the heat.
+// With SINGLE_DRAG_TRIGGER there is no start line, so RT is left at 0 and ET is the total.
+// A lane that did not reach the finish line before the DRAG_HEAT_TIMEOUT is given a dragDNF.
+void CalcDragSlip(){
+  for (byte i = 1; i <= 2; i++){
+    dragRT[i] = 0;
+    if (laneEnableStatus[i] == Off || lapCount[i] < 2) {
+      dragET[i] = dragDNF;
+      dragTotal[i] = dragDNF;
+      continue;
+    }
+    if (!SINGLE_DRAG_TRIGGER) dragRT[i] = dragMicros[i][0] - dragGreenMicros;
+    dragTotal[i] = dragMicros[i][1] - dragGreenMicros;
+    dragET[i] = dragTotal[i] - dragRT[i];
+  }
+}
+
+// Returns the winning lane of the drag heat worked out by CalcDragSlip(), 0 if neither lane raced.
+// The lower total wins. A tie on the total goes to the quicker reaction time, then to lane 1,
+// so a heat always has exactly 1 winner, and an Elimination always knocks a racer out.
+byte DragWinner(){
+  if (laneEnableStatus[1] == Off) return (laneEnableStatus[2] == Off ? 0 : 2);
+  if (laneEnableStatus[2] == Off) return 1;
+  if (dragTotal[1] != dragTotal[2]) return (dragTotal[1] < dragTotal[2] ? 1 : 2);
+  return (dragRT[2] < dragRT[1] ? 2 : 1);
+}
+
+// Prints the drag timing slip, one lane per row, to LCD rows 1-3.
+// The winning lane is marked with a '*'. Each racer's LED shows their RT and total.
+void PrintDragSlip(){
+  byte winLane = DragWinner();
+  if (dragTotal[winLane] == dragDNF) winLane = 0;
+  lcd.setCursor(0, 1);
+  lcd.print(F("Ln    RT    ET   Tot"));
+  for (byte i = 1; i <= 2; i++){
+    PrintSpanOfChars(lcdDisp, i + 1);
+    lcd.setCursor(0, i + 1);
+    lcd.print(i);
+    if (i == winLane) lcd.print('*');
+    if (laneEnableStatus[i] == Off) continue;
+    lc.clearDisplay(displays(i) - 1);
+    if (dragTotal[i] == dragDNF) {
+      PrintText("DNF", lcdDisp, 19, 3, true, i + 1);
+      PrintText("DNF", displays(i), 7, 3, true);
+      continue;
+    }
+    if (SINGLE_DRAG_TRIGGER) {
+      PrintText("-", lcdDisp, 7, 5, true, i + 1);
+    } else {
+      PrintClock(dragRT[i] / 1000, 7, 5, 3, lcdDisp, i + 1);
+      PrintClock(dragRT[i] / 1000, 3, 4, 3, displays(i));
+    }
+    PrintClock(dragET[i] / 1000, 13, 5, 3, lcdDisp, i + 1);
+    PrintClock(dragTotal[i] / 1000, 19, 5, 3, lcdDisp, i + 1);
+    PrintClock(dragTotal[i] / 1000, 7, 4, 3, displays(i));
+  }
+}
+
+
+
+// ******* SECTOR TIMING FUNCTIONS ******************
+// Logs the sector splits of a lane's just completed lap alongside its lap in the lastXMillis que,
+// and updates the racer's best sector splits.
+// Must be run while processing the completed lap, before the next lap can end.
+void LogSectorSplits(byte lane){
+  // que idx of the completed lap's end timestamp
+  byte lapIdx = (lapCount[lane] - 1) % lapMillisQSize;
+  lastXSectorMillis[lane][lapIdx] = 0;
+  // If the sector sensor wasn't crossed on the completed lap there is nothing to log.
+  if (sectorLap[lane] != lapCount[lane] - 1) return;
+  unsigned long sector1 = sectorMillis[lane] - lastXMillis[lane][(lapCount[lane] - 2) % lapMillisQSize];
+  unsigned long sector2 = lastXMillis[lane][lapIdx] - sectorMillis[lane];
+  lastXSectorMillis[lane][lapIdx] = sector1;
+  if (bestSectorMillis[lane][0] == 0 || sector1 < bestSectorMillis[lane][0]) bestSectorMillis[lane][0] = sector1;
+  if (bestSectorMillis[lane][1] == 0 || sector2 < bestSectorMillis[lane][1]) bestSectorMillis[lane][1] = sector2;
+}
+
+// Prints a sector split to the lane's LED, as the sector # and its delta to the racer's best.
+// A '-' marks a split faster than the best. Until there is a best, the split itself is shown.
+void PrintSectorDelta(byte lane, byte sector, unsigned long split, unsigned long best){
+  lc.clearDisplay(displays(lane) - 1);
+  PrintText("S", displays(lane), 0, 1);
+  PrintNumbers(sector, 1, 1, displays(lane));
+  if (best == 0) {
+    PrintClock(split, 7, 5, 3, displays(lane));
+  } else {
+    if (split < best) PrintText("-", displays(lane), 3, 1);
+    PrintClock(split < best ? best - split : split - best, 7, 4, 3, displays(lane));
+  }
+}
+
+
+// ******* TOURNAMENT FUNCTIONS ******************
+// Returns the # of enabled lanes that will be filled in each heat.
+// Drag racing only uses lanes 1 & 2, regardless of laneCount.
+byte TourneyLaneCount(){
+  byte heatLanes = 0;
+  for (byte i = 1; i <= (DragRace() ? 2 : laneCount); i++){
+    if (laneEnableStatus[i] > 0) heatLanes++;
+  }
+  return heatLanes;
+}
+
+// Clears the standings and assigns the racers for the 1st heat.
+// Returns false if the roster is too small to fill the enabled lanes.
+bool TourneyBegin(){
+  byte heatLanes = TourneyLaneCount();
+  if (heatLanes == 0 || tourneyRosterSize < heatLanes) return false;
+  for (byte i = 1; i <= laneCount; i++){
+    tourneySavedStatus[i] = laneEnableStatus[i];
+    tourneySavedRacer[i] = laneRacer[i];
+  }
+  tourneySaved = true;
+  memset(tourneyPoints, 0, sizeof(tourneyPoints));
+  memset(tourneyOut, 0, sizeof(tourneyOut));
+  tourneyHeat = 0;
+  tourneyCursor = 0;
+  tourneyOver = false;
+  TourneyNextHeat();
+  return true;
+}
+
+// Puts back the lane settings and racers the operator had before the tournament.
+void TourneyRestore(){
+  if (!tourneySaved) return;
+  // Every lane is cleared first, so a racer moved between lanes isn't seen as taken.
+  for (byte i = 1; i <= laneCount; i++) SetLaneRacer(i, 0);
+  enabledLaneCount = 0;
+  for (byte i = 1; i <= laneCount; i++){
+    laneEnableStatus[i] = tourneySavedStatus[i];
+    SetLaneRacer(i, tourneySavedRacer[i]);
+    if (laneEnableStatus[i] != Off) enabledLaneCount++;
+  }
+  setTriggerMask();
+  tourneySaved = false;
+}
+
+// Assigns the roster racers of the next heat to the enabled lanes.
+// RoundRobin shifts the lane order by one racer each heat, so over a full round
+// every racer starts once from every lane position.
+// Elimination fills the lanes with the next racers still in the tournament.
+void TourneyNextHeat(){
+  byte aliveCount = 0;
+  for (byte r = 1; r <= tourneyRosterSize; r++){
+    if (!tourneyOut[r]) aliveCount++;
+  }
+  // A round robin is complete after one heat per racer on the roster.
+  if ((tourneyMode == RoundRobin && tourneyHeat >= tourneyRosterSize) ||
+      (tourneyMode == Elimination && aliveCount < 2)) {
+    tourneyOver = true;
+    return;
+  }
+  byte cursor = tourneyCursor;
+  for (byte i = 1; i <= (DragRace() ? 2 : laneCount); i++){
+    if (laneEnableStatus[i] == Off) continue;
+    if (aliveCount == 0) {
+      // Late in an elimination there may be fewer racers left than lanes,
+      // in which case the extra lanes sit out the rest of the tournament.
+      SetLaneRacer(i, 0);
+      laneEnableStatus[i] = Off;
+      enabledLaneCount--;
+      continue;
+    }
+    // skip over racers that have been knocked out
+    while (tourneyOut[cursor % tourneyRosterSize + 1]) cursor++;
+    SetLaneRacer(i, cursor % tourneyRosterSize + 1);
+    cursor++;
+    aliveCount--;
+  }
+  tourneyCursor = (tourneyMode == RoundRobin ? tourneyCursor + 1 : cursor % tourneyRosterSize);
+}
+
+// Adds the places of the heat just finished to the running standings.
+// Only the racers in this heat are updated, nothing is recalculated from earlier heats.
+// Must be run before the Finish state resets the lanes to StandBy.
+void TourneyScoreHeat(){
+  // lane of the last place racer, to be knocked out in an Elimination
+  byte lastLane = 0;
+  if (DragRace()) {
+    // Drag heats are decided by the us totals worked out on entry to the Finish state.
+    byte winLane = DragWinner();
+    for (byte i = 1; i <= 2; i++){
+      if (laneEnableStatus[i] == Off || laneRacer[i] > tourneyRosterSize) continue;
+      bool won = (i == winLane);
+      tourneyPoints[laneRacer[i]] += tourneyPlacePoints[won ? 1 : 2];
+      if (!won) lastLane = i;
+    }
+  } else {
+    // Circuit heats use the places of the final leader board.
+    for (byte place = 0; place < enabledLaneCount; place++){
+      byte lane = leaderBoard[place][1];
+      // Racers picked from outside the roster by hand don't score.
+      if (lane == 0 || laneRacer[lane] > tourneyRosterSize) continue;
+      // A racer who did not finish, ie. race was ended from a pause, scores as a DNF.
+      tourneyPoints[laneRacer[lane]] += tourneyPlacePoints[laneEnableStatus[lane] == Finished ? place + 1 : 0];
+      lastLane = lane;
+    }
+  }
+  if (tourneyMode == Elimination && lastLane > 0) tourneyOut[laneRacer[lastLane]] = true;
+  tourneyHeat++;
+}
+
+// Prints the selected tournament mode to the 'Start a Race' menu.
+void PrintTourneyMode(){
+  lcd.setCursor(13, 2);
+  switch (tourneyMode) {
+    case RoundRobin:
+      lcd.print(F("#|Heats"));
+    break;
+    case Elimination:
+      lcd.print(F("#|Elim "));
+    break;
+    default:
+      lcd.print(F("#|Once "));
+    break;
+  }
+}
+
+// Prints the top 3 racers of the tournament standings to LCD rows 1-3.
+// A skull is printed next to racers knocked out of an Elimination.
+void PrintStandings(){
+  // racer name idx of each printed place, so no racer is listed twice.
+  byte ranked[3] = {0, 0, 0};
+  for (byte row = 0; row < 3; row++){
+    PrintSpanOfChars(lcdDisp, row + 1);
+    int bestPoints = -1;
+    for (byte r = 1; r <= tourneyRosterSize; r++){
+      bool listed = false;
+      for (byte k = 0; k < row; k++){
+        if (ranked[k] == r) listed = true;
+      }
+      if (!listed && (int)tourneyPoints[r] > bestPoints){
+        bestPoints = tourneyPoints[r];
+        ranked[row] = r;
+      }
+    }
+    if (ranked[row] == 0) break;
+    PrintNumbers(row + 1, 1, 0, lcdDisp, true, row + 1);
+    PrintText(RacerName(ranked[row]), lcdDisp, 11, 10, false, row + 1, false);
+    PrintNumbers(tourneyPoints[ranked[row]], 3, 16, lcdDisp, false, row + 1);
+    if (tourneyOut[ranked[row]]) {
+      lcd.setCursor(18, row + 1);
+      lcd.write(3);
+    }
+  }
+}
+
+// ******* SEASON STANDINGS ******************
+// Each racer's running totals across races, kept in EEPROM so they carry on between power ups.
+// When a race finishes, only the records of the racers in it are read, added to, and written back.
+// Nothing is worked out again from earlier races, so they don't need to be kept.
+// The average lap is a running mean and variance (Welford's method) of each race's average lap,
+// so the spread of a racer's pace is known without storing every race.
+#if SEASON_STANDINGS
+const uint16_t seasonMagic = 0x5E01;
+struct SeasonHeader {
+  uint16_t magic;
+  // # of races scored this season
+  uint16_t races;
+};
+struct SeasonRecord {
+  unsigned int points;
+  byte races;
+  byte wins;
+  // # of races with at least 1 lap, the sample count of lapMean and lapM2.
+  byte lapRaces;
+  // ms, 0 = no lap yet
+  unsigned int bestLap;
+  // Mean of the racer's race average laps, in ms.
+  float lapMean;
+  // Sum of the squared differences from the mean, the variance is lapM2 / (lapRaces - 1).
+  float lapM2;
+};
+// By default the season is stored right after the race checkpoint's slots.
+#if SEASON_EEPROM_ADDR >= 0
+  const int seasonAddr = SEASON_EEPROM_ADDR;
+#elif RACE_CHECKPOINT
+  const int seasonAddr = CHECKPOINT_EEPROM_ADDR + CHECKPOINT_SLOTS * sizeof(RaceCheckpoint);
+#else
+  const int seasonAddr = 0;
+#endif
+const int seasonFit = (E2END + 1 - seasonAddr - (int)sizeof(SeasonHeader)) / (int)sizeof(SeasonRecord);
+static_assert(SEASON_ROSTER_SIZE <= (E2END + 1 - seasonAddr - (int)sizeof(SeasonHeader)) / (int)sizeof(SeasonRecord), "SEASON_ROSTER_SIZE racers don't fit in EEPROM.");
+// # of racers in the season, taken from the start of the racer names list, skipping the 'Off' label.
+const byte seasonSize =
+  (SEASON_ROSTER_SIZE > 0 && SEASON_ROSTER_SIZE < racerListSize) ? SEASON_ROSTER_SIZE :
+  (racerListSize - 1 < seasonFit ? racerListSize - 1 : seasonFit);
+// Points awarded per finishing place, idx0 is DNF.
+const byte seasonPlacePoints[5] = SEASON_POINTS;
+// Results of the finished race, held until they can be written to EEPROM.
+struct SeasonResult {
+  byte racer;
+  // finishing place, 0 = DNF
+  byte place;
+  unsigned long bestLap;
+  // the race's average lap in ms, 0 if no laps were completed
+  unsigned long avgLap;
+};
+SeasonResult seasonResults[laneCount];
+byte seasonResultCount = 0;
+// # of racers listed on the season page, the last time it was printed.
+byte seasonListed = 0;
+// Set by the '0' key on the season page, then the '#' key clears the season.
+bool seasonClearArmed = false;
+
+int SeasonRecordAddr(byte racer) {
+  return seasonAddr + sizeof(SeasonHeader) + (racer - 1) * sizeof(SeasonRecord);
+}
+
+// Zeros the season. ~3.4ms per EEPROM byte that isn't already 0, so up to a few seconds.
+void SeasonClear() {
+  SeasonHeader header = {seasonMagic, 0};
+  eeprom_update_block(&header, (void *)seasonAddr, sizeof(header));
+  for (byte r = 1; r <= seasonSize; r++) {
+    #if WATCHDOG
+      wdt_reset();
+    #endif
+    for (byte i = 0; i < sizeof(SeasonRecord); i++) eeprom_update_byte((uint8_t *)(SeasonRecordAddr(r) + i), 0);
+  }
+}
+
+// Run once in setup(). Starts a new season if EEPROM doesn't hold one.
+void SeasonBegin() {
+  if (eeprom_read_word((const uint16_t *)seasonAddr) != seasonMagic) SeasonClear();
+}
+
+// Holds the result of the racer in 'lane' for SeasonUpdate(). Racers outside the season aren't kept.
+void SeasonLogResult(byte lane, byte place, unsigned long bestLap, unsigned long avgLap) {
+  byte racer = laneRacer[lane];
+  if (racer == 0 || racer > seasonSize) return;
+  seasonResults[seasonResultCount++] = {racer, place, bestLap, avgLap};
+}
+
+// Takes the results of the race just finished.
+// Must be run before the Finish state resets the lanes to StandBy.
+void SeasonScoreRace(){
+  seasonResultCount = 0;
+  if (DragRace()) {
+    // A tie is broken the same way as for a tournament heat, see DragWinner().
+    byte winLane = DragWinner();
+    for (byte i = 1; i <= 2; i++){
+      if (laneEnableStatus[i] == Off) continue;
+      if (dragTotal[i] == dragDNF) {
+        SeasonLogResult(i, 0, 0, 0);
+        continue;
+      }
+      SeasonLogResult(i, i == winLane ? 1 : 2, fastestTimes[i][0], fastestTimes[i][0]);
+    }
+  } else {
+    for (byte place = 0; place < enabledLaneCount; place++){
+      byte lane = leaderBoard[place][1];
+      if (lane == 0) continue;
+      int laps = (lapCount[lane] == 0) ? 0 : lapCount[lane] - 1;
+      SeasonLogResult(lane,
+        laneEnableStatus[lane] == Finished ? place + 1 : 0,
+        laps > 0 ? fastestTimes[lane][0] : 0,
+        laps > 0 ? racersTotalTime[lane] / laps : 0);
+    }
+  }
+}
+
+// Run at the top of every loop(). Adds the finished race's results to the season records of its racers.
+void SeasonUpdate() {
+  if (seasonResultCount == 0) return;
+  #if RACE_CHECKPOINT
+    // Wait for the finished race's checkpoint to be closed, so a reset can't resume, and score, the race twice.
+    // This also keeps these writes out of the way of the checkpoint's background writes.
+    if (checkpointWriting || checkpoint.live) return;
+  #endif
+  for (byte k = 0; k < seasonResultCount; k++) {
+    SeasonResult &res = seasonResults[k];
+    SeasonRecord rec;
+    eeprom_read_block(&rec, (const void *)SeasonRecordAddr(res.racer), sizeof(rec));
+    rec.points += seasonPlacePoints[res.place];
+    if (rec.races < 255) rec.races++;
+    if (res.place == 1 && rec.wins < 255) rec.wins++;
+    if (res.bestLap > 0 && res.bestLap < 65535 && (rec.bestLap == 0 || res.bestLap < rec.bestLap)) rec.bestLap = res.bestLap;
+    if (res.avgLap > 0 && rec.lapRaces < 255) {
+      rec.lapRaces++;
+      float delta = res.avgLap - rec.lapMean;
+      rec.lapMean += delta / rec.lapRaces;
+      rec.lapM2 += delta * (res.avgLap - rec.lapMean);
+    }
+    // Only the changed bytes are written.
+    eeprom_update_block(&rec, (void *)SeasonRecordAddr(res.racer), sizeof(rec));
+  }
+  SeasonHeader header;
+  eeprom_read_block(&header, (const void *)seasonAddr, sizeof(header));
+  header.races++;
+  eeprom_update_block(&header, (void *)seasonAddr, sizeof(header));
+  seasonResultCount = 0;
+}
+
+// Sort key of a racer, highest 1st. Points, then wins, then the lower name idx.
+unsigned long SeasonRankKey(byte racer, unsigned int points, byte wins) {
+  return ((unsigned long)points << 16) | ((unsigned int)wins << 8) | (255 - racer);
+}
+
+// Prints 3 places of the season standings to LCD rows 1-3, starting from place 'firstPlace' + 1.
+// If 'showPoints', each row shows points and wins, otherwise best and average lap.
+// The places are found by selection, each the highest key below the last, so no sorted list is kept.
+void PrintSeason(byte firstPlace, bool showPoints) {
+  PrintText(RESULTS_SEASON_LBL, lcdDisp, 8, 9, false, 0);
+  lcd.setCursor(10, 0);
+  if (showPoints) lcd.print(F("  Pts  Won"));
+  else lcd.print(F(" Best  Avg"));
+  unsigned long lastKey = 0xFFFFFFFF;
+  seasonListed = 0;
+  for (byte place = 0; place < seasonSize; place++) {
+    byte best = 0;
+    unsigned long bestKey = 0;
+    SeasonRecord rec, bestRec;
+    for (byte r = 1; r <= seasonSize; r++) {
+      eeprom_read_block(&rec, (const void *)SeasonRecordAddr(r), sizeof(rec));
+      if (rec.races == 0) continue;
+      unsigned long key = SeasonRankKey(r, rec.points, rec.wins);
+      if (key < lastKey && key >= bestKey) {
+        bestKey = key;
+        best = r;
+        bestRec = rec;
+      }
+    }
+    if (best == 0) break;
+    lastKey = bestKey;
+    seasonListed++;
+    if (place < firstPlace) continue;
+    if (place >= firstPlace + 3) break;
+    byte line = place - firstPlace + 1;
+    PrintSpanOfChars(lcdDisp, line);
+    PrintNumbers(place + 1, 2, 1, lcdDisp, false, line);
+    PrintText(RacerName(best), lcdDisp, 9, 7, false, line, false);
+    if (showPoints) {
+      PrintNumbers(bestRec.points, 4, 14, lcdDisp, false, line);
+      PrintNumbers(bestRec.wins, 3, 19, lcdDisp, false, line);
+    } else {
+      PrintClock(bestRec.bestLap, 14, 5, 2, lcdDisp, line);
+      PrintClock((unsigned long)bestRec.lapMean, 19, 5, 2, lcdDisp, line);
+    }
   }
-  InitializeRacerArrays();
-  finishedCount = 0;
-  overallFastestTime = 99999;
-  overallFastestRacer = 0;
+  // Clear any rows left over from a longer list.
+  // seasonListed counts 1 place past the last row, when there is one, so it's known if there are more to scroll to.
+  byte shown = seasonListed > firstPlace ? seasonListed - firstPlace : 0;
+  for (byte line = shown + 1; line <= 3; line++) PrintSpanOfChars(lcdDisp, line);
 }
+#endif
+
 
 
 
@@ -1835,6 +5132,16 @@ void PrintAudioStatus() {
 // ***************** SETUP *********************
 // Initialize hardware and establish software initial state
 void setup(){
+  // Keep the reason for the reset, then clear it. After a watchdog reset the watchdog is left on, so it's turned off
+  // until setup() is done. Optiboot leaves MCUSR cleared, and the flags it saved in r2 are used instead.
+  resetFlags = (MCUSR != 0 ? MCUSR : bootResetFlags);
+  MCUSR = 0;
+  wdt_disable();
+  #if DISPLAY_COPROC > 1
+    // A display coprocessor only runs the displays.
+    CoprocSetup();
+    return;
+  #endif
   // --- SETUP SERIAL ------------------------
   /*
   NOTE: Serial port is only used in debugging at the moment.
@@ -1847,14 +5154,27 @@ void setup(){
   // Open port and wait for connection before proceeding.
   // Serial.begin(9600);
   // while(!Serial);
+  // The Diagnostics Menu can dump its latency histograms to serial, without waiting for a connection.
+  #if DIAGNOSTICS_SERIAL
+    Serial.begin(9600);
+  #endif
+  #if DISPLAY_COPROC == 1
+    Serial.begin(COPROC_BAUD);
+  #endif
 
   // --- SETUP LCD DIPSLAY -----------------------------
+  #if I2C_ASYNC
+    TwiSetup();
+  #endif
   // Initialize LCD with begin() which will return zero on success.
-  // Non-zero failure status codes are defined in <hd44780.h>
-	// lcd.begin(LCD_COLS, LCD_ROWS);
-	int status = lcd.begin(LCD_COLS, LCD_ROWS);
+  // Non-zero failure status codes are defined in <hd44780.h>, AsyncLCD returns 1 if the backpack didn't respond.
+  int status = lcd.begin(LCD_COLS, LCD_ROWS);
   // If display initialization fails, trigger onboard error LED if exists.
-	if(status) hd44780::fatalError(status);
+  #if I2C_ASYNC
+    if(status) AsyncLCD::fatalError(status);
+  #else
+    if(status) hd44780::fatalError(status);
+  #endif
   // Clear display of any residual data, ensure it starts in a blank state
   lcd.clear();
   // --- CREATE CUSTOM LCD CHARS -------------
@@ -1879,22 +5199,52 @@ void setup(){
   }
   // Initialize Adafruit Bargraph
   // use actual address from documentation if not the same as '0x70'
-  bar.begin(BARGRAPH_I2C_ADDRESS);
+  #if !BUILD_BARGRAPH || DISPLAY_COPROC == 1
+  #elif I2C_ASYNC
+    BargraphSetup();
+  #else
+    bar.begin(BARGRAPH_I2C_ADDRESS);
+  #endif
 
   // --- SETUP LAP TRIGGERS AND BUTTONS ----------------
   setTriggerMask();
   for (byte i = 1; i <= laneCount; i++){
     // Equivalent to digitalWrite(lane_Pin, HIGH)
     pinMode(lanes[i][0], INPUT_PULLUP);
+    if (laneSectors[i][0] != 255) pinMode(laneSectors[i][0], INPUT_PULLUP);
     // Set all lanes to default, enabled status, StandBy
     laneEnableStatus[i] = StandBy;
     // Set default racer names for each lane.
-    laneRacer[i] = i;
+    SetLaneRacer(i, i);
     // maintain a count of the enabled lanes for indexing loops to reference.
     enabledLaneCount++;
   }
   pinMode(pauseStopPin, INPUT);
   pinMode(startButtonPin, INPUT);
+  ButtonSamplerSetup();
+  #if KEYPAD_INTERRUPTS
+    KeypadSetup();
+  #endif
+  TickSetup();
+  #if TRACK_SIMULATOR
+    SimSetup();
+  #endif
+  #if LINK_NODE
+    LinkSetup();
+  #endif
+  #if SD_ARCHIVE
+    ArchiveSetup();
+    if (!archiveReady) {
+      lcd.print(F("No SD card archive"));
+      delay(2000);
+      lcd.clear();
+    }
+  #endif
+  #if LINK_NODE > 1
+    // A slave's lane triggers are always on, it only reports them to the master.
+    lcd.clear();
+    EnablePinInterrupts(true);
+  #endif
 
   // Initialize racer data arrays.
   ResetRaceVars();
@@ -1903,6 +5253,13 @@ void setup(){
   // Set initial state to Menu and initial menu to MainMenu, turn initial entry flag on.
   ChangeStateTo(Menu);
   currentMenu = MainMenu;
+  #if SEASON_STANDINGS
+    SeasonBegin();
+  #endif
+  #if RACE_CHECKPOINT
+    // If the controller was reset in the middle of a race, pick it back up, paused.
+    if (CheckpointResume()) ChangeStateTo(Paused);
+  #endif
 
   // Startup test song when using melody arrays.
   // melodyPlaying = true;
@@ -1918,6 +5275,9 @@ void setup(){
   UpdateAudioBools();
   Beep();
 
+  #if WATCHDOG
+    wdt_enable(WATCHDOG_TIMEOUT);
+  #endif
 }
 // ************* END SETUP *******************
 
@@ -1929,8 +5289,43 @@ void setup(){
 void loop(){
   // Serial.println("MAIN LOOP START");
   // Serial.println(state);
+  // Log the time of the last loop() iteration against the state it ran in.
+  unsigned long loopMicros = micros();
+  LogLatency(loopLatencyHist[loopState], loopMicros - loopStartMicros, LOOP_HIST_BASE_SHIFT);
+  #if BUS_ACCOUNTING
+    LogBus();
+  #endif
+  loopStartMicros = loopMicros;
+  loopState = state;
+  #if WATCHDOG
+    // If loop() stops coming back around, such as from a locked up I2C bus, the watchdog resets the controller.
+    wdt_reset();
+  #endif
+  #if DISPLAY_COPROC > 1
+    CoprocLoop();
+    return;
+  #endif
+  #if LINK_NODE > 1
+    // A linked slave only runs the link.
+    LinkSlaveLoop();
+    return;
+  #elif LINK_NODE
+    LinkUpdate();
+  #endif
+  #if SD_ARCHIVE
+    ArchiveUpdate();
+  #endif
+  #if RACE_CHECKPOINT
+    CheckpointUpdate();
+  #endif
+  #if SEASON_STANDINGS
+    SeasonUpdate();
+  #endif
   // This function is required to be called every loop to facilitate non-blocking audio.
-  updatePlayRtttl();
+  // It returns false once a song has finished, which the idle power manager checks before powering down.
+  songPlaying = updatePlayRtttl();
+  // Redraw any LED name marquee the Timer1 tick has stepped.
+  if (marqueeDue) MarqueeDraw();
   // ----- enable if using Note arrays ----------
   // if(melodyPlaying && musicAudioOn){
   //   if(millis() - lastNoteMillis >= noteDelay){
@@ -1950,14 +5345,16 @@ void loop(){
       // In the 'Menu' state the program is focused on looking for keypad input
       // and using that keypad input to navigate the menu tree and adjust settings.
       // Serial.println("entering Menu STATE");
-      char key = keypad.getKey();
+      char key = GetKey();
+      // Once a tournament is left, and its results are no longer showing, the lanes are set back as they were.
+      if (tourneySaved && currentMenu != ResultsMenu) TourneyRestore();
       if (entryFlag) {
         // Clear the lap log interrupts on initial entry into menu state just to make sure,
         // but DON'T clear entry flag here, it is used at the menu level in the menu state.
         // This means these interrupts get disabled on every new menu, but keeps things simpler.
         EnablePinInterrupts(false);
         // If the last race was a Drag race then set data flag to 'no data'
-        if (raceType == Drag) raceDataExists = false;
+        if (DragRace()) raceDataExists = false;
         // Turn on yellow startlights
         lc.clearDisplay(laneCount);
         for (byte i = 3; i < 6; i++){
@@ -2013,6 +5410,13 @@ void loop(){
               currentMenu = ResultsMenu;
               resultsMenuIdx = 0;
               entryFlag = true;
+              break;
+            // The Diagnostics Menu is hidden, and not listed on the Main Menu.
+            case '0':
+              currentMenu = DiagnosticsMenu;
+              diagMenuIdx = 0;
+              entryFlag = true;
+              break;
             default:
               break;
           } // END key switch
@@ -2088,6 +5492,7 @@ void loop(){
           if (entryFlag) {
             // write base, static text to screen
             UpdateLCDMenu(SelectRacersText);
+            racerPrefixLen = 0;
             // Write all current racer names to LCD
             for(byte i = 1; i <= laneCount; i++){
               // If the lane is disabled
@@ -2096,12 +5501,12 @@ void loop(){
                 lcd.setCursor(nameEndPos - 10, i - 1);
                 lcd.write(3);
                 // Then print disabled lane label (ie. '-Off-')
-                PrintText(Racers[0], lcdDisp, nameEndPos, 9, false, i - 1);
+                PrintText(RacerName(0), lcdDisp, nameEndPos, 9, false, i - 1);
                 // and another skull
-                lcd.setCursor(nameEndPos - 7 + strlen(Racers[laneRacer[0]]), i - 1);
+                lcd.setCursor(nameEndPos - 7 + strlen(RacerName(laneRacer[0])), i - 1);
                 lcd.write(3);
               } else {
-                PrintText(Racers[laneRacer[i]], lcdDisp, nameEndPos, 11, false, i - 1);
+                PrintText(RacerName(laneRacer[i]), lcdDisp, nameEndPos, 11, false, i - 1);
               }
             }
             entryFlag = false;
@@ -2112,15 +5517,33 @@ void loop(){
               byte laneNumber = key - 'A' + 1;
               // Make sure lane is enabled and exists before trying to set a racer name
               if(laneEnableStatus[laneNumber] && (laneNumber <= laneCount)){
+                // Picking a different lane starts a new T9 prefix.
+                if (laneNumber != racerPrefixLane) racerPrefixLen = 0;
+                racerPrefixLane = laneNumber;
                 // Cycle to next racer name, if end of list, start back at 1 not 0.
                 // The zero index is reserved for the disabled lane label.
-                laneRacer[laneNumber] = IndexRacer(laneNumber);
-                // Update LCD with new racer name
-                PrintText(Racers[ laneRacer[laneNumber] ], lcdDisp, nameEndPos, 11, false, laneNumber-1);
-                // Update Racer's LED
-                PrintText(Racers[ laneRacer[laneNumber] ], displays(laneNumber), 7, 8);
-                // Play racers victory song
-                if (musicAudioOn && !SONGS_BY_PLACE) startPlayRtttlPGM(buzzPin1, victorySong[ laneRacer[laneNumber] ]);
+                SetLaneRacer(laneNumber, IndexRacer(laneNumber));
+                ShowPickedRacer(laneNumber);
+              }
+            }
+            break;
+            // Jump the last picked lane to the first free name spelled by the keys, T9 style.
+            case '0' ... '9':{
+              if (laneEnableStatus[racerPrefixLane] && TypeRacerPrefix(racerPrefixLane, key)) {
+                ShowPickedRacer(racerPrefixLane);
+              } else Boop();
+            }
+            break;
+            // Jump the last picked lane directly to a racer by its # in the names list.
+            case '#':{
+              if (laneEnableStatus[racerPrefixLane]) {
+                byte racer = EditNumber(racerNumDigits, racerListSize - 1, racerPrefixLane - 1, nameEndPos + 1 - racerNumDigits);
+                if (racer > 0 && (racer == laneRacer[racerPrefixLane] || !RacerInUse(racer))) {
+                  SetLaneRacer(racerPrefixLane, racer);
+                } else Boop();
+                racerPrefixLen = 0;
+                // also redraws the name over the entered number
+                ShowPickedRacer(racerPrefixLane);
               }
             }
             break;
@@ -2149,19 +5572,38 @@ void loop(){
             PrintNumbers(raceSetTime[0], 2, START_RACE_TIME_ENDPOS_IDX, lcdDisp, true, 1);
             // Print sey preStartCountDown
             PrintNumbers(preStartCountDown, 2, START_RACE_CNTDWN_ENDPOS_IDX, lcdDisp, true, 3);
+            // Print tournament mode
+            PrintTourneyMode();
             entryFlag = false;
           }
           switch (key) {
             // Laps or Timed Race Selected
             case 'A': case 'B': case 'C': {
+              // Race types that aren't built are ignored.
+              if (key == 'C' ? !BUILD_DRAG : !BUILD_CIRCUIT) break;
               endLap = raceLaps;
               countingDown = false;
-              if (key == 'A') raceType = Standard;
-              else if (key == 'B') {raceType = Timed; countingDown = true;}
-              else if (key == 'C') {raceType = Drag; endLap = 1;}
+              #if BUILD_CIRCUIT
+                if (key == 'A') raceType = Standard;
+                else if (key == 'B') {raceType = Timed; countingDown = true;}
+                else if (key == 'C') raceType = Drag;
+              #endif
+              if (key == 'C') endLap = 1;
+              // If a tournament is selected, line up the 1st heat.
+              // If there aren't enough racers to fill the lanes, run a single race instead.
+              if (tourneyMode == NoTourney || !TourneyBegin()) {
+                tourneyMode = NoTourney;
+                tourneyOver = false;
+              }
               ChangeStateTo(Staging);
             }
             break;
+            // Cycle tournament mode
+            case '#': {
+              tourneyMode = tourneyModes((tourneyMode + 1) % 3);
+              PrintTourneyMode();
+            }
+            break;
             case 'D': {
               // Change duration of pre-race countdown.
               preStartCountDown = EditNumber(2, 30, 3, 18);
@@ -2189,6 +5631,11 @@ void loop(){
               lcd.print(COMPILING);
               CompileTopFastest();
               UpdateResultsMenu();
+            } else if (SEASON_STANDINGS) {
+              // With no race since power up, the season standings can still be looked at.
+              resultsMenuIdx = resultsSeasonIdx;
+              resultsRowIdx = 0;
+              UpdateResultsMenu();
             } else {
               lcd.clear();
               lcd.print(NO_RACE_DATA);
@@ -2197,26 +5644,34 @@ void loop(){
           }
           // This block tracks when to flip between,
           // title A (Racer # label) and B (racer name)
-          // only execute if on an individual racer screen, not Top, or Final results.
+          // only execute if on an individual racer screen, or the season standings, not Top, or Final results.
           if ( (curMillis - lastXMillis[0][0] > RESULTS_RACER_BLINK)
-                && (resultsMenuIdx != 0)
-                && (resultsMenuIdx != laneCount+1) ) {
+                && (((resultsMenuIdx != 0) && (resultsMenuIdx <= laneCount)) || (resultsMenuIdx == resultsSeasonIdx)) ) {
             titleA = !titleA;
             lastXMillis[0][0] = curMillis;
             UpdateResultsMenu(false);
             // Serial.println("lastMillis trigger: ");
           }
+          #if SEASON_STANDINGS
+            if (key && key != '#') seasonClearArmed = false;
+          #endif
           switch (key) {
             // Scroll up or down the lap results list
             case 'A': case 'B':{
               // Only deal with data if it exists,
               // otherwise garbage will be displayed on screen.
-              if(raceDataExists) {
+              if(raceDataExists || resultsMenuIdx == resultsSeasonIdx) {
                 // Clear lines to remove extra ch from long names replace by short ones.
                 PrintSpanOfChars(lcdDisp, 1);
                 PrintSpanOfChars(lcdDisp, 2);
                 PrintSpanOfChars(lcdDisp, 3);
                 if (key == 'A' && resultsRowIdx > 0) resultsRowIdx--;
+                #if SEASON_STANDINGS
+                  // The season scrolls while there are places below the 3 shown.
+                  if (resultsMenuIdx == resultsSeasonIdx) {
+                    if (key == 'B' && seasonListed > resultsRowIdx + 3) resultsRowIdx++;
+                  } else
+                #endif
                 // Subtract 2 because there are two rows printed after tracked index.
                 if (key == 'B' && resultsRowIdx < DEFAULT_MAX_STORED_LAPS - 2) resultsRowIdx++;
                 UpdateResultsMenu();
@@ -2230,8 +5685,12 @@ void loop(){
               // otherwise garbage will be displayed on screen
               if(raceDataExists) {
                 // Index results menu to next racer.
-                // The +2 is to account for top results and leader board pages.
-                resultsMenuIdx = (resultsMenuIdx + 1) % (laneCount + 2);
+                // After the racers are the leader board, tournament standings, and season standings pages,
+                // skipping the tournament standings if one isn't running.
+                do {
+                  resultsMenuIdx = (resultsMenuIdx + 1) % (resultsSeasonIdx + 1);
+                } while ((resultsMenuIdx == laneCount + 2 && tourneyMode == NoTourney)
+                      || (resultsMenuIdx == resultsSeasonIdx && !SEASON_STANDINGS));
                 // Reset row index to 0 so new list starts at the top
                 resultsRowIdx = 0;
                 UpdateResultsMenu();
@@ -2242,6 +5701,28 @@ void loop(){
               }
             }
             break;
+            #if SEASON_STANDINGS
+            // On the season page, '0' then '#' clears the season.
+            case '0':{
+              if (resultsMenuIdx == resultsSeasonIdx) {
+                seasonClearArmed = true;
+                lcd.setCursor(0, 0);
+                lcd.print(F("Clear season? #|Yes "));
+              }
+            }
+            break;
+            case '#':{
+              if (resultsMenuIdx == resultsSeasonIdx && seasonClearArmed) {
+                seasonClearArmed = false;
+                lcd.clear();
+                lcd.print(F("Clearing season..."));
+                SeasonClear();
+                resultsRowIdx = 0;
+                UpdateResultsMenu();
+              }
+            }
+            break;
+            #endif
             case '*':{
               // Return to MainMenu
               currentMenu = MainMenu;
@@ -2253,6 +5734,49 @@ void loop(){
           } // END of keypad switch
         } // END of ResultsMenu Case
         break;
+
+        case DiagnosticsMenu: {
+          curMillis = millis();
+          // Refresh the live stats at the results blink period.
+          if (entryFlag || curMillis - lastXMillis[0][0] > RESULTS_RACER_BLINK) {
+            // Turn on the lane triggers, so the sensors can be tested from the menu.
+            if (entryFlag) EnablePinInterrupts(true);
+            lastXMillis[0][0] = curMillis;
+            UpdateDiagnosticsMenu();
+            entryFlag = false;
+          }
+          switch (key) {
+            // Clear the stats to start a new test
+            case 'A':
+              ResetSensorStats();
+              ResetLatencyStats();
+              #if BUS_ACCOUNTING
+                ResetBusStats();
+              #endif
+              #if TRACK_SIMULATOR
+                SimResetReport();
+              #endif
+              UpdateDiagnosticsMenu();
+            break;
+            // Dump the histograms to the serial port
+            case 'B':
+              SerialDumpLatency();
+            break;
+            // Cycle through the diagnostics pages
+            case 'C': case 'D':
+              diagMenuIdx = (diagMenuIdx + 1) % diagPageCount;
+              UpdateDiagnosticsMenu();
+            break;
+            case '*':
+              EnablePinInterrupts(false);
+              currentMenu = MainMenu;
+              entryFlag = true;
+            break;
+            default:
+            break;
+          } // END of keypad switch
+        } // END of DiagnosticsMenu Case
+        break;
         default:
         break;
       }; // END of Menu switch
@@ -2281,12 +5805,14 @@ void loop(){
         lcd.setCursor(1, 0);
         lcd.print(F("*P|Exit    #S|Race"));
         switch (raceType) {
+          #if BUILD_DRAG
           case Drag: {
             // For drag racing, drop racer names and label the lanes
             PrintText("Lane   1", led1Disp, 7, 8);
             PrintText("Lane   2", led2Disp, 7, 8);
           }
           break;
+          #endif
           default:
           break;
         }
@@ -2299,7 +5825,7 @@ void loop(){
       } // END of entryFlag
 
       // After entry, monitor for user input to decide next state
-      char key = keypad.getKey();
+      char key = GetKey();
       // If Start button or '#' key is pressed, initiate a race, and switch to PreStart state.
       if( buttonPressed(startButtonPin) || key == '#' ) {
         ChangeStateTo(PreStart);
@@ -2328,7 +5854,7 @@ void loop(){
       if (entryFlag) {
         // Serial.println(F("Pst"));
         // Set live race time to preStartCountDown wich is in seconds, so convert to millis.
-        currentTime[0] = (raceType == Drag ? preStartTimerDrag : preStartCountDown) * 1000;
+        currentTime[0] = (DragRace() ? preStartTimerDrag : preStartCountDown) * 1000;
         // Record current loop's ms timestamp to track display update, tick time.
         lastTickMillis = curMillis;
         lcd.clear();
@@ -2336,6 +5862,7 @@ void loop(){
         if (newRace) ResetRaceVars();
 
         switch (raceType) {
+          #if BUILD_DRAG
           case Drag: {
             // Update the LCD to indicate race is now 'staged', aka in active pre-start state.
             lcd.setCursor(2,0);
@@ -2358,6 +5885,7 @@ void loop(){
             if(laneEnableStatus[2]) pciSetup(lanes[2][0]);
           }
           break;
+          #endif
           default: {
             // Else, if a circuit race (standard or timed) then,
             // Draw pre-start circuit race text to LCD and LEDs
@@ -2382,83 +5910,72 @@ void loop(){
         // set flag to trigger turning off startlights after a delay.
         clearStartLight = true;
         entryFlag = false;
+        // Hand the countdown to the Timer1 interrupt, it will change the state to Race at the green.
+        StartLightBegin(currentTime[0]);
       } // END 'entryFlag' conditional
 
+      // The remaining countdown, as counted by the Timer1 interrupt.
+      noInterrupts();
+      currentTime[0] = startLightTicks;
+      interrupts();
       // If the display update tick time has passed, update elapsed race time on LCD
       if (curMillis - lastTickMillis > displayTick){
-        currentTime[0] = currentTime[0] - displayTick;
         // If not a drag race, update timer on LCD
-        if (raceType != Drag) {
+        if (!DragRace()) {
+            // The countdown clock is refreshed every tick, so it's dropped first if the I2C queue is filling up.
+            SetTwiPriority(TwiLow);
             PrintClock(currentTime[0], PRESTART_CLK_POS, 4, 2, lcdDisp, 2);
+            SetTwiPriority(TwiNormal);
         } 
         lastTickMillis = curMillis;
       }
 
-      // If pre-start countdown is greater than 0, execute display and start light updates
-      if (currentTime[0] > 0){
-        // If remaining pre-start countdown drops below next update period, process new period
-        if (currentTime[0] < nextStageCountdownTime) {
-          nextStageCountdownTime -= preStartTick;
-
-          switch (raceType){
-            case Drag: {
-              // for the first cycle of the final countdown ticks, indicate final 3 ticks have begun
-              if (ledCountdownTemp == 1){
-                lcd.clear();
-                lcd.setCursor(8, 2);
-                lcd.print(F("Set!"));
-                // clear the racer LED dipslays
-                if(laneEnableStatus[1]) lc.clearDisplay(led1Disp-1);
-                if(laneEnableStatus[2]) lc.clearDisplay(led2Disp-1);
-                // clear, ready & set lights on MAX7219 start light tree.
-                lc.clearDisplay(laneCount);
-                // lc.setLed(laneCount, 1, 2+ledCountdownTemp, false);
-              }
-              // write start light final ticks to Racer LEDs
-              if(laneEnableStatus[1]) PrintText("--", led1Disp, 1+3*(ledCountdownTemp-1), 2);
-              if(laneEnableStatus[2]) PrintText("--", led2Disp, 1+3*(ledCountdownTemp-1), 2);
-              // Add next start tick to Adafruit bar
-              setBargraph(LED_YELLOW, (10 - ledCountdownTemp*3), (9 - ledCountdownTemp*3));
-              setBargraph(LED_YELLOW, (14 + ledCountdownTemp*3), (13 + ledCountdownTemp*3));
-              // update MAX7219 start light; light the next yellow LED
+      // Show each start light step the Timer1 interrupt has reached.
+      while (startLightStepShown != startLightStep) {
+        startLightStepShown++;
+        switch (raceType){
+          #if BUILD_DRAG
+          case Drag: {
+            // for the first cycle of the final countdown ticks, indicate final 3 ticks have begun
+            if (ledCountdownTemp == 1){
+              lcd.clear();
+              lcd.setCursor(8, 2);
+              lcd.print(F("Set!"));
+              // clear the racer LED dipslays
+              if(laneEnableStatus[1]) lc.clearDisplay(led1Disp-1);
+              if(laneEnableStatus[2]) lc.clearDisplay(led2Disp-1);
+              // clear, ready & set lights on MAX7219 start light tree.
               lc.clearDisplay(laneCount);
-              lc.setLed(laneCount, 0, 2+ledCountdownTemp, true);
-              lc.setLed(laneCount, 1, 2+ledCountdownTemp, true);
-              ledCountdownTemp++;
-            }
-            break;
-              // if a circuit race (ie Standard or Timed)
-            default: {
-              // Write current seconds digit to all active LEDs
-              ledWriteDigits(ledCountdownTemp);
-              // set next 3rd of LED bar yellow
-              setBargraph(LED_YELLOW, ((ledCountdownTemp*8)-1), (ledCountdownTemp-1)*8);
-              // update MAX7219 start light; light the next yellow LED
-              lc.setLed(laneCount, 0, 3+(3-ledCountdownTemp), true);
-              lc.setLed(laneCount, 1, 3+(3-ledCountdownTemp), true);
-              ledCountdownTemp--;
+              // lc.setLed(laneCount, 1, 2+ledCountdownTemp, false);
             }
-            break;
-          } // END of raceType switch
-          Beep();
-        }
-      } else { // countdown is 0
-        // The prestart state has finished and the race should start.
-        if (raceType == Drag) {
-          // for drag race, update LCD
-          lcd.setCursor(0, 2);
-          lcd.print(F("Go! Go! Go! Go! Go! "));
-        }
-        // reset ledCountdownTemp to default for next race
-        ledCountdownTemp = 0;
-        // Turn adafruit start light to green
-        setBargraph(LED_GREEN);
-        // Turn on MAX7219 start light tree - green LEDs
-        lc.clearDisplay(laneCount);
-        lc.setLed(laneCount, 0, 6, true);
-        lc.setLed(laneCount, 1, 6, true);
-        // Move on to live race, it's now legal for racers to cross start
-        ChangeStateTo(Race);
+            // write start light final ticks to Racer LEDs
+            if(laneEnableStatus[1]) PrintText("--", led1Disp, 1+3*(ledCountdownTemp-1), 2);
+            if(laneEnableStatus[2]) PrintText("--", led2Disp, 1+3*(ledCountdownTemp-1), 2);
+            // Add next start tick to Adafruit bar
+            setBargraph(LED_YELLOW, (10 - ledCountdownTemp*3), (9 - ledCountdownTemp*3));
+            setBargraph(LED_YELLOW, (14 + ledCountdownTemp*3), (13 + ledCountdownTemp*3));
+            // update MAX7219 start light; light the next yellow LED
+            lc.clearDisplay(laneCount);
+            lc.setLed(laneCount, 0, 2+ledCountdownTemp, true);
+            lc.setLed(laneCount, 1, 2+ledCountdownTemp, true);
+            ledCountdownTemp++;
+          }
+          break;
+          #endif
+            // if a circuit race (ie Standard or Timed)
+          default: {
+            // Write current seconds digit to all active LEDs
+            ledWriteDigits(ledCountdownTemp);
+            // set next 3rd of LED bar yellow
+            setBargraph(LED_YELLOW, ((ledCountdownTemp*8)-1), (ledCountdownTemp-1)*8);
+            // update MAX7219 start light; light the next yellow LED
+            lc.setLed(laneCount, 0, 3+(3-ledCountdownTemp), true);
+            lc.setLed(laneCount, 1, 3+(3-ledCountdownTemp), true);
+            ledCountdownTemp--;
+          }
+          break;
+        } // END of raceType switch
+        Beep();
       }
     } // END of PreStart state
     break;
@@ -2467,254 +5984,16 @@ void loop(){
     // **********  RACE state  *****************
     // The 'Race' state manages the active race.
     case Race:{
-      curMillis = millis();
-      // First cycle initialization of RACE and signalling of START.
       if (entryFlag) {
-        // Serial.println(F("rce"));
-        if (raceType != Drag) {
-          lcd.clear();
-          PrintLeaderBoard(!newRace);
-        }
-        if(newRace){
-          // make sure running race time is starting from 0
-          currentTime[0] = 0;
-          // record the ms clock time at race start
-          startMillis[0] = curMillis;
-          if (raceType == Drag) {
-            // set lanes Active on race start and set current lap to 1
-            for(byte i = 1; i <= laneCount; i++){
-              if(laneEnableStatus[i] == StandBy){
-                laneEnableStatus[i] = Active;
-                // If using a start and finish line triggers, set lapCount to 0 (or 'false')
-                // If using a finish line only, set lapCount to 1 (or 'true')
-                lapCount[i] = SINGLE_DRAG_TRIGGER;
-                flashStatus[i] = 1;
-                startMillis[i] = curMillis;
-              }
-            }
-          }
-          newRace = false;
-        } else { // if newRace = false, returning from a restart.
-          startMillis[0] = curMillis - lastXMillis[0][2];
-        }
-        // Cycle through possible lanes and write start notification to racer displays.
-        for(byte i = 1; i <= laneCount; i++){
-          if(laneEnableStatus[i] == StandBy){
-            PrintText(Start, displays(i), 7, 8, true, 0, true);
-          } else if(laneEnableStatus[i] == Off){
-            PrintText(Racers[0], displays(i), 7, 8, true, 0, true);
-          }
-          // Set flash status to default, idle state.
-          flashStatus[i] = 0;
-          Bleep();
-        }
-        // Reset display tick timestamp to current loop's timestamp.
-        lastTickMillis = curMillis;
+        // The UI is drawn first, as it shows if this is a new race, or a restart.
+        RaceUiBegin();
+        RaceTimingBegin();
         entryFlag = false;
-      } // END Race State entryFlag
-
-      // ********* LIVE RACE **********
-      // For Circuit Racing, after 2sec (ie 2000ms), turn start lights off.
-      if(clearStartLight && raceType != Drag){
-        if ((curMillis - startMillis[0]) >= START_LIGHT_OFF_DELAY) {
-          // clear Adafruit Bargraph
-          setBargraph(LED_OFF);
-          clearStartLight = false;
-          // clear MAX7219 start light tree
-          lc.clearDisplay(laneCount);
-        }
-      }
-
-      // Update current racetime.
-      if (countingDown) {
-        // When counting down we need to gaurd against negatives.
-        currentTime[0] = raceSetTimeMs < (curMillis - startMillis[0]) ? 0 : raceSetTimeMs - (curMillis - startMillis[0]);
-      } else {
-        // Lap based race time counts up until final lap finished by 1st racer.
-        currentTime[0] = curMillis - startMillis[0];
-      }
-
-      // For each possible lane check its flash status and process the data and displays accordingly.
-      for(byte i = 1; i <= laneCount; i++){
-        // Only bother to process lanes with 'Active' status.
-        if(laneEnableStatus[i] == Active) {
-          // Update elapsed, ms time for lane.
-          // If it's a drag race, use the race time, timestamp, not the racer's lap start timestamp.
-          currentTime[i] = curMillis - (raceType == Drag ? startMillis[0] : startMillis[i]);
-
-          switch (flashStatus[i]) {
-            // If Flash OFF - update running laptime to LED displays
-            case 0:{
-              if (curMillis - lastTickMillis >  displayTick){
-                PrintNumbers(lapCount[i], 3, 2, displays(i));
-                PrintClock(currentTime[i], 7, 5, 1, displays(i), 0);
-              }
-            }
-            break;
-            // If Flash START - a lap has just been completed, show its time on LED and process its data.
-            case 1: {
-              unsigned long lapTimeToLog;
-              // Log the loop timestamp at start of this flash period.
-              flashStartMillis[i] = curMillis;
-              // Calculate the lap time of the just finished lap.
-              // If it's a drag race use the race start time instead of lane's lap start trigger.
-
-              switch (raceType) {
-                case Drag: {
-                  lapTimeToLog = curMillis - startMillis[0];
-                  flashStatus[i] = 0;
-                }
-                break;
-                // Circuit Racing types, Standard & Timed
-                default: {
-                  lapTimeToLog = lastXMillis [i] [(lapCount[i]-1) % lapMillisQSize] - lastXMillis [i] [(lapCount[i]-2) % lapMillisQSize];
-                  UpdateFastestLap(fastestTimes[i], fastestLaps[i], (lapCount[i] - 1), lapTimeToLog, laneRacer[i], DEFAULT_MAX_STORED_LAPS);
-                  // Update the racer's LED with the completed lap # and laptime.
-                  lc.clearDisplay( displays(i) - 1 );
-                  // print the just completed lap # to left side of racer's  LED
-                  PrintNumbers( (lapCount[i] - 1), 3, 2, displays(i));
-                  // print the lap time of just completed lap to right side of racer's LED
-                  PrintClock(lapTimeToLog, 7, 4, 3, displays(i));
-                  UpdateLiveRaceLCD();
-                  flashStatus[i] = 2;
-                }
-                break;
-              }
-              // update the total run time for racer
-              racersTotalTime[i] = racersTotalTime[i] + lapTimeToLog;
-              // Set the Results Menu data exist flag to true.
-              raceDataExists = true;
-            }
-            break;
-            // Flash HOLD - do nothing until flash period has elapsed.
-            case 2:{
-              // if flash time is up, set flag to zero ending display of last lap
-              if (curMillis - flashStartMillis[i] > flashDisplayTime) flashStatus[i] = 0;
-            }
-            break;
-            default:
-            break;
-          } // END flashStatus switch
-        } else {
-          // else if NOT an 'Active' lane
-          currentTime[i] = 0;
-        } // END of if then else, lane enabled, ie 'Active'.
-      } // END for each lane loop
-      
-      // If a tick has passed then update displays.
-      if (curMillis - lastTickMillis >  displayTick){
-        // Update the main LCD
-        if (raceType != Drag) PrintClock(currentTime[0], RACE_CLK_POS, 10, 1, lcdDisp, 0, true);
-        lastTickMillis = curMillis;
       }
-
-      // FINISHING CHECK - check for the race end conditions.
-      switch (raceType) {
-        case Standard: case Drag:{
-          // If it's a drag race check the heat timeout has not passed
-          if (raceType == Drag) {
-            if (curMillis - startMillis[0] > DRAG_HEAT_TIMEOUT * 1000) {
-              finishedCount = 2;
-              // set lanes that did not finish to high lap time
-              if (lapCount[1]<2) startMillis[1] = 999999;
-              if (lapCount[2]<2) startMillis[2] = 999999;
-            }
-          }
-          // ****** STANDARD FINSIH *******************
-          // Check if any Active lanes have since finished.
-          for(byte i = 1; i <= laneCount; i++){
-            if(laneEnableStatus[i] == Active){
-              // If a lanes's current lapCount is greater than the 'endLap' that means
-              // they have finished the race. lapCount of an 'Active' lane, is +1 of finsished laps.
-              // Because the final lap count can be updated at any time via interrupts,
-              // we must also verify that the flash status is not still '1'.
-              // If flash status = 1 then lap data has not been processed yet
-              // so do not process racer as finished until that is done.
-              if( (lapCount[i] > endLap) && (flashStatus[i] != 1)){
-                // Change racer's status to finished
-                laneEnableStatus[i] = Finished;
-                // Turn off lap trigger interrupt of finished lane.
-                clearPCI(lanes[i][0]);
-                finishedCount++;
-
-                // Update the racer's LED display with their finishing place.
-                switch (raceType) {
-                  case Drag: {
-                    PrintClock(startMillis[i]-startMillis[0], 7, 5, 3, displays(i), 0);
-                    // For a Drag Race, light up LED of 1st lane to finish
-                    // if (finishedCount == 0) {
-                    if (!winner) {
-                      lc.clearDisplay(laneCount);
-                      lc.setLed(laneCount, i-1, 0, true);
-                      setBargraph(LED_OFF);
-                      // index (i), will be 1 or 2, but the MAX7219 index is zero based.
-                      // lane 1 should light LEDs 0-11; lane 2 should light LEDs 12-23.
-                      setBargraph(LED_GREEN, i*12 - 1, (i-1)*12);
-                      winner = true;
-                    }
-                  }
-                  break;
-                  default: {
-                     UpdateNameOnLED(i);
-                    // Stop any currently playing song
-                    stopPlayRtttl();
-                    // Play finishing song of finishing racer
-                    if (SONGS_BY_PLACE) {
-                      if (musicAudioOn) startPlayRtttlPGM(buzzPin1, victorySong[finishedCount]);
-                    } else {
-                      if (musicAudioOn) startPlayRtttlPGM(buzzPin1, victorySong[laneRacer[i]]);
-                    }
-                  }
-                  break;
-                } // END raceType switch
-              } // END if Finish lapcount reached
-            } // END if lane is active
-          } // END for each lane
-
-          // The race continues until all racers have finsihed.
-          // If drag racing then only 2 racers should be used regardless of enabled laneCount
-          if (finishedCount == (raceType == Drag ? 2 : enabledLaneCount)) {
-            // If all racers have completed all laps, transition to Finished state.
-            ChangeStateTo(Finish);
-            // Serial.print("Finished then enabled count: ");
-            // Serial.println(finishedCount);
-            // Serial.println(enabledLaneCount);
-          }
-        } // END Standard Race Finishing case
-        break;
-        case Timed:{
-          // ****** TIMED FINSIH *******************
-          // if time <= 0 then race is over.
-          if (currentTime[0] <= 0) {
-            // Turn off all lap trigger interrupts.
-            EnablePinInterrupts(false);
-            for(byte i = 1; i <= laneCount; i++){
-              if(laneEnableStatus[i] == Active){
-                // Set lanes to finished state and write places to LEDs.
-                laneEnableStatus[i] = Finished;
-                UpdateNameOnLED(i);
-              }
-            }
-            finishedCount = laneCount;
-            // Stop any currently playing song
-            stopPlayRtttl();
-            // Play finishing song of 1st place racer.
-            if (SONGS_BY_PLACE) {
-              if (musicAudioOn) startPlayRtttlPGM(buzzPin1, victorySong[1]);
-            } else {
-              if (musicAudioOn) startPlayRtttlPGM(buzzPin1, victorySong[laneRacer[leaderBoard[0][1]]]);
-            }
-            // if (musicAudioOn) startPlayRtttlPGM(buzzPin1, victorySong[laneRacer[leaderBoard[0][1]]]);
-            ChangeStateTo(Finish);
-          }
-        } // END Timed race case
-        break;
-        default:
-        break;
-      } // END RaceType Switch (Finishing Check)
-
+      RaceTimingStep();
+      RaceUiStep();
       // Check analog pause button for press, debouncing is done in 'buttonPressed'
-      if (buttonPressed(pauseStopPin)) ChangeStateTo(Paused);
+      if (state == Race && buttonPressed(pauseStopPin)) ChangeStateTo(Paused);
 
     } // END of Race state case
     break;
@@ -2727,10 +6006,13 @@ void loop(){
       if(entryFlag){
         // Log ms timestamp & current elapsed race time, upon iniation of Pause.
         // This will be used to update race time on restart froma pause.
+        // A Timed race's clock counts down, so its elapsed time is what's left taken from the set time.
         lastXMillis[0][1] = millis();
-        lastXMillis[0][2] = currentTime[0];
+        lastXMillis[0][2] = (countingDown ? raceSetTimeMs - currentTime[0] : currentTime[0]);
         // immediately turn off the interrupts on the lap sensing pins
         EnablePinInterrupts(false);
+        // The deadline is set again, past the paused period, on the restart.
+        raceDeadlineOn = false;
         // Put all 'Active' race lanes into 'StandBy'.
         for (byte i = 1; i <= laneCount; i++){
           if(laneEnableStatus[i] == Active) {
@@ -2753,13 +6035,13 @@ void loop(){
           currentTime[i] = 0;
         }
         // Adjust race clock start time to ignore the paused period
-        // currentTime[0] is the elapsed race time in ms at time of pause.
-        startMillis[0] = startMillis[0] + (logMillis - startMillis[0] - currentTime[0]);
+        // lastXMillis[0][2] is the elapsed race time in ms at time of pause.
+        startMillis[0] = logMillis - lastXMillis[0][2];
         // Re-enable lap triggers on active lanes.
         EnablePinInterrupts(true);
       } else {
         // Check if star is pressed on keypad, if so then end game and got to results.
-        char key = keypad.getKey();
+        char key = GetKey();
         if (key == '*') {
           UpdateAllNamesOnLEDs();
           ChangeStateTo(Finish);
@@ -2796,11 +6078,18 @@ void loop(){
           // If bit i is a 1, then process it as a trigger on that lane number
           if(lastTriggeredPins & lanes[lnNum][1]){
             faultCount++;
-            if (raceType == Drag){
-              PrintText("Lane ", lcdDisp, 3, 4, false, faultCount);
-              PrintNumbers(lnNum, 1, 5, lcdDisp, false, 1);
+            #if SD_ARCHIVE
+              ArchiveAppend(ArchFault, lnNum, 0, DragRace() ? dragRedLightMicros[lnNum] / 1000 : 0);
+            #endif
+            if (DragRace()){
+              // A drag lane's red light is listed on its own row with how far it left ahead of the green.
+              PrintText("Lane ", lcdDisp, 3, 4, false, lnNum);
+              PrintNumbers(lnNum, 1, 5, lcdDisp, false, lnNum);
+              lcd.setCursor(8, lnNum);
+              lcd.print('-');
+              PrintClock(dragRedLightMicros[lnNum] / 1000, 13, 5, 3, lcdDisp, lnNum);
             } else {
-              PrintText(Racers[laneRacer[lnNum]], lcdDisp, 19, 20, false, faultCount);
+              PrintText(RacerName(laneRacer[lnNum]), lcdDisp, 19, 20, false, faultCount);
             }
             // setLed(deviceID, digit index, segment, On?)
             lc.setLed(laneCount, lnNum-1, 7, true);
@@ -2818,7 +6107,7 @@ void loop(){
         entryFlag = false;
       } // END if(entryFlag)
 
-      char key = keypad.getKey();
+      char key = GetKey();
       if( buttonPressed(pauseStopPin) || buttonPressed(startButtonPin) || key == '*' || key == '#') {
         lcd.clear();
         // Clear bargraph and/or LED start tree
@@ -2841,51 +6130,78 @@ void loop(){
       if (entryFlag) {
         // Serial.println(F("fnsh"));
         switch (raceType) {
+          #if BUILD_DRAG
           case Drag: {
-            // Print finish text to LCD
-            // lcd.clear();            
-            lcd.setCursor(0, 1);
-            lcd.print(F("--Lane 1----Lane 2--"));
-            PrintSpanOfChars(lcdDisp, 2);
+            // Turn off the lap triggers of any lane that timed out.
+            EnablePinInterrupts(false);
+            CalcDragSlip();
             // Set the fastest LAPS idx 0, to be lap #1
             fastestLaps[1][0] = 1;
             fastestLaps[2][0] = 1;
-            // log drag finish time (lap 2 start - race start), as the top fastest lap for racer
-            fastestTimes[1][0] = startMillis[1] - startMillis[0];
-            fastestTimes[2][0] = startMillis[2] - startMillis[0];
+            // log drag total (green to finish line), in ms, as the top fastest lap for racer
+            fastestTimes[1][0] = (dragTotal[1] == dragDNF ? 999999 : dragTotal[1] / 1000);
+            fastestTimes[2][0] = (dragTotal[2] == dragDNF ? 999999 : dragTotal[2] / 1000);
             // correct total time to only include drag race time for each lane.
             racersTotalTime[1] = fastestTimes[1][0];
             racersTotalTime[2] = fastestTimes[2][0];
-            PrintClock(fastestTimes[1][0], 7, 5, 3, lcdDisp, 2);
-            PrintClock(fastestTimes[2][0], 17, 5, 3, lcdDisp, 2);
-
-            // UpdateFastestLap(fastestTimes[i], fastestLaps[i], (lapCount[i] - 1), fastestTimes[1][0], laneRacer[i], DEFAULT_MAX_STORED_LAPS);
-            if (fastestTimes[1][0] < fastestTimes[2][0]) {
-              PrintText("Winner", lcdDisp, 7, 6, false, 3);
-            } else if (fastestTimes[2][0] < fastestTimes[1][0]) {
-              PrintText("Winner", lcdDisp, 17, 6, false, 3);
-            }
+            // Print the timing slip to the LCD and racer LEDs
+            PrintDragSlip();
             lcd.setCursor(1, 0);
             lcd.print(F("*P|Exit    #S|Race"));
           } // END Drag case
           break;
+          #endif
           default:
           break;
         } // END of raceType switch
 
+        // Score the heat before lane states are reset.
+        if (tourneyMode != NoTourney) TourneyScoreHeat();
+        #if SEASON_STANDINGS
+          SeasonScoreRace();
+        #endif
+        #if TRACK_SIMULATOR
+          SimCheckRace();
+        #endif
+
         // Reset lane states to StandBay
         for (byte i = 1; i <= laneCount; i++){
           if(laneEnableStatus[i] > 0) laneEnableStatus[i] = StandBy;
         }
+
+        // Line up the next heat while the finish screen is still showing,
+        // so the next heat can be staged with a single start press.
+        if (tourneyMode != NoTourney) {
+          TourneyNextHeat();
+          if (!DragRace()) {
+            lcd.clear();
+            if (tourneyOver) {
+              PrintText(RESULTS_STANDINGS_LBL, lcdDisp, 19, 20, false, 0);
+              PrintStandings();
+            } else {
+              // Show the heat's final leader board, with the next heat's names on the LEDs.
+              PrintLeaderBoard(true);
+              lcd.setCursor(0, 0);
+              lcd.print(F("Ht"));
+              PrintNumbers(tourneyHeat, 2, 3, lcdDisp, true, 0);
+              lcd.print(F(" #|Next"));
+              UpdateAllNamesOnLEDs();
+            }
+          } else if (tourneyOver) {
+            lcd.setCursor(0, 0);
+            lcd.print(F(" Tournament Over!   "));
+          }
+        }
         entryFlag = false;
 
       } // END of Finish state entryFlag
 
       switch (raceType) {
         // If in drag race mode, then wait for user input to exit or return to staging.
+        #if BUILD_DRAG
         case Drag:{
-          char key = keypad.getKey();
-          if (buttonPressed(startButtonPin) || key == '#'){
+          char key = GetKey();
+          if ((buttonPressed(startButtonPin) || key == '#') && !tourneyOver){
             ChangeStateTo(Staging);
           } else if ( buttonPressed(pauseStopPin) || key == '*') {
             ChangeStateTo(Menu);
@@ -2893,13 +6209,22 @@ void loop(){
           }
         }
         break;
+        #endif
         // Timed and Standard races fall into the default
         // If it's a circuit race, then default to exiting to results menu on finish.
+        // During a tournament, wait on the finish screen for the next heat to be started.
+        // A simulator soak test also waits here, for the simulator to start the next race.
         default: {
-          ChangeStateTo(Menu);
-          currentMenu = ResultsMenu;
-          resultsMenuIdx = 0;
-          resultsRowIdx = 0;
+          bool holdOnFinish = (tourneyMode != NoTourney || SIM_SOAK);
+          char key = (holdOnFinish ? GetKey() : NO_KEY);
+          if (holdOnFinish && !tourneyOver && (buttonPressed(startButtonPin) || key == '#')) {
+            ChangeStateTo(Staging);
+          } else if (!holdOnFinish || buttonPressed(pauseStopPin) || key == '*') {
+            ChangeStateTo(Menu);
+            currentMenu = ResultsMenu;
+            resultsMenuIdx = 0;
+            resultsRowIdx = 0;
+          }
         }
         break;
       } // END raceType switch
@@ -2914,6 +6239,7 @@ void loop(){
     break;
   } // END of States Switch
 
+  IdleSleep();
 } // END of MAIN LOOP
 // ********************************************************
 // ********************************************************
@@ -2922,6 +6248,453 @@ void loop(){
 
 
 
+// ******* RACE CONTEXTS ******************
+// See RaceEvent for how the Race state is split between them.
+
+// # of free places in the race event queue, one is always left empty so full and empty can be told apart.
+byte RaceEventsFree(){
+  byte head = raceEventHead;
+  byte tail = raceEventTail;
+  byte used = (head >= tail ? head - tail : head + raceEventQSize - tail);
+  return raceEventQSize - 1 - used;
+}
+
+// Posts an event from the timing context to the UI context.
+// The timing context checks there's room before changing any race data, so an event is never dropped.
+void RacePost(raceEvents type, byte lane, int data, unsigned long time){
+  if (RaceEventsFree() == 0) return;
+  RaceEvent &ev = raceEventQ[raceEventHead];
+  ev.type = type;
+  ev.lane = lane;
+  ev.data = data;
+  ev.time = time;
+  raceEventHead = (raceEventHead + 1) % raceEventQSize;
+}
+
+void ClearRaceEvents(){
+  raceEventHead = raceEventTail = 0;
+}
+
+// Returns true if a lap logged by the lane interrupts hasn't been processed yet.
+bool LapsPending(){
+  for (byte i = 1; i <= laneCount; i++) {
+    if (flashStatus[i] == 1) return true;
+  }
+  return false;
+}
+
+// Timestamp of a lane's final crossing, the finish line crossing of a drag lane, in us.
+unsigned long FinishStamp(byte lane){
+  #if BUILD_DRAG
+    if (DragRace()) return dragMicros[lane][1];
+  #endif
+  return lastXMillis[lane][endLap % lapMillisQSize];
+}
+
+// Posts a finished lane to the UI context, with its place if it's to play its song, or 0 if it's only being redrawn.
+void PostFinish(byte lane, byte place){
+  #if BUILD_DRAG
+    RacePost(EvFinished, lane, place, DragRace() ? (dragMicros[lane][1] - dragGreenMicros) / 1000 : 0);
+  #else
+    RacePost(EvFinished, lane, place, 0);
+  #endif
+}
+
+// Finishes the Active lanes that have crossed the line on their last lap, in the order they crossed it,
+// not the order of their lane #, however many have crossed since the last check.
+// A lane's place is 1 more than the # of finished lanes that crossed before it. A lane timed by a linked slave
+// can be reported after a lane that crossed later, which then drops a place, and is redrawn.
+void FinishLanes(){
+  while (true) {
+    // The next lane to have crossed, of those still to be finished.
+    byte lane = 0;
+    unsigned long stamp = 0;
+    for (byte i = 1; i <= laneCount; i++) {
+      if (laneEnableStatus[i] != Active || lapCount[i] <= endLap) continue;
+      unsigned long iStamp = FinishStamp(i);
+      if (lane == 0 || (long)(iStamp - stamp) < 0) {
+        lane = i;
+        stamp = iStamp;
+      }
+    }
+    // Room is kept for the lane, and for redrawing every other lane.
+    if (lane == 0 || RaceEventsFree() < laneCount) return;
+    // Change racer's status to finished
+    laneEnableStatus[lane] = Finished;
+    // Turn off lap trigger interrupt of finished lane.
+    clearPCI(lanes[lane][0]);
+    if (laneSectors[lane][0] != 255) clearPCI(laneSectors[lane][0]);
+    finishedCount++;
+    byte place = 1;
+    for (byte i = 1; i <= laneCount; i++) {
+      if (i == lane || laneEnableStatus[i] != Finished) continue;
+      long ahead = (long)(stamp - FinishStamp(i));
+      if (ahead > 0) {
+        place++;
+      } else if (ahead == 0) {
+        // Crossed at the same timestamp, they share the place.
+        finishTie[lane] = true;
+        if (!finishTie[i]) {
+          finishTie[i] = true;
+          if (finishPlace[i] > 0) PostFinish(i, 0);
+        }
+      } else if (finishPlace[i] > 0) {
+        finishPlace[i]++;
+        PostFinish(i, 0);
+      }
+    }
+    finishPlace[lane] = place;
+    PostFinish(lane, place);
+  }
+}
+
+// Timing context set up, on entering the Race state.
+void RaceTimingBegin(){
+  curMillis = millis();
+  if(newRace){
+    // make sure running race time is starting from 0
+    currentTime[0] = 0;
+    // record the ms clock time the start lights turned green as the race start
+    // Drag lanes have already been set Active, at the green, by the PreStart state.
+    startMillis[0] = greenMillis;
+    newRace = false;
+  } else { // if newRace = false, returning from a restart.
+    startMillis[0] = curMillis - lastXMillis[0][2];
+  }
+  raceOverPosted = false;
+  if (countingDown) {
+    noInterrupts();
+    raceDeadlineMillis = startMillis[0] + raceSetTimeMs;
+    raceDeadlineOn = true;
+    interrupts();
+  }
+}
+
+// Processes the crossings logged by the lane interrupts, updates the race clock, and checks for the finish.
+// Anything to be shown is posted to the UI context. Lap data is only taken once there's room to post it,
+// otherwise it's left waiting, as logged by the interrupt, until the next loop().
+void RaceTimingStep(){
+  curMillis = millis();
+  if (raceOverPosted) return;
+  // If the Timer1 interrupt has just gone green, show it before anything else.
+  if (startLightGreen && RaceEventsFree() > 0) {
+    startLightGreen = false;
+    RacePost(EvGreen, 0, 0, 0);
+  }
+
+  // Update current racetime.
+  if (countingDown) {
+    // When counting down we need to gaurd against negatives.
+    currentTime[0] = raceSetTimeMs < (curMillis - startMillis[0]) ? 0 : raceSetTimeMs - (curMillis - startMillis[0]);
+  } else {
+    // Lap based race time counts up until final lap finished by 1st racer.
+    currentTime[0] = curMillis - startMillis[0];
+  }
+
+  for(byte i = 1; i <= laneCount; i++){
+    // Only bother to process lanes with 'Active' status.
+    if(laneEnableStatus[i] != Active) {
+      currentTime[i] = 0;
+      continue;
+    }
+    // Update elapsed, ms time for lane.
+    // If it's a drag race, use the race time, timestamp, not the racer's lap start timestamp.
+    currentTime[i] = curMillis - (DragRace() ? startMillis[0] : startMillis[i]);
+
+    // If a sector split was logged on the current lap, post it so its delta to the racer's best sector 1 split is flashed.
+    if (sectorFlash[i] && RaceEventsFree() > 0) {
+      noInterrupts();
+      bool sameLap = (sectorLap[i] == lapCount[i]);
+      unsigned long split = sectorMillis[i] - startMillis[i];
+      sectorFlash[i] = false;
+      interrupts();
+      if (sameLap) RacePost(EvSector, i, 1, split);
+    }
+
+    // A lap has just been completed, process its data.
+    // Room is kept for the lap, and the finish it may cause.
+    if (flashStatus[i] == 1 && RaceEventsFree() > 1) {
+      unsigned long lapTimeToLog;
+      // Calculate the lap time of the just finished lap.
+      // If it's a drag race use the race start time instead of lane's lap start trigger.
+      switch (raceType) {
+        #if BUILD_DRAG
+        case Drag: {
+          lapTimeToLog = curMillis - startMillis[0];
+        }
+        break;
+        #endif
+        // Circuit Racing types, Standard & Timed
+        default: {
+          lapTimeToLog = lastXMillis [i] [(lapCount[i]-1) % lapMillisQSize] - lastXMillis [i] [(lapCount[i]-2) % lapMillisQSize];
+          UpdateFastestLap(fastestTimes[i], fastestLaps[i], (lapCount[i] - 1), lapTimeToLog, laneRacer[i], DEFAULT_MAX_STORED_LAPS);
+          LogSectorSplits(i);
+          UpdateGap(i);
+          UpdateLeaderBoard();
+          RacePost(EvLap, i, lapCount[i] - 1, lapTimeToLog);
+        }
+        break;
+      }
+      // update the total run time for racer
+      racersTotalTime[i] = racersTotalTime[i] + lapTimeToLog;
+      #if SD_ARCHIVE
+        ArchiveAppend(ArchLap, i, lapCount[i] - 1, lapTimeToLog);
+      #endif
+      // Set the Results Menu data exist flag to true.
+      raceDataExists = true;
+      flashStatus[i] = 0;
+    }
+  } // END for each lane loop
+
+  // FINISHING CHECK - check for the race end conditions.
+  switch (raceType) {
+    case Standard: case Drag:{
+      // If it's a drag race check the heat timeout has not passed
+      if (DragRace()) {
+        if (curMillis - startMillis[0] > DRAG_HEAT_TIMEOUT * 1000) {
+          // lanes that did not finish are given a DNF by CalcDragSlip() in the Finish state
+          finishedCount = 2;
+        }
+      }
+      // ****** STANDARD FINSIH *******************
+      // Check if any Active lanes have since finished.
+      // Because the final lap count can be updated at any time via interrupts, finishes are only taken
+      // once every lap logged has been processed, so lanes that finish close together are placed as they crossed.
+      if (!LapsPending()) FinishLanes();
+      // The race continues until all racers have finsihed.
+      // If drag racing then only 2 racers should be used regardless of enabled laneCount
+      if (finishedCount == (DragRace() ? 2 : enabledLaneCount) && RaceEventsFree() > 0) {
+        RacePost(EvRaceOver, 0, 0, 0);
+        raceOverPosted = true;
+      }
+    } // END Standard Race Finishing case
+    break;
+    case Timed:{
+      // ****** TIMED FINSIH *******************
+      // if time <= 0 then race is over.
+      // The lane interrupts stop counting laps at the deadline themselves, so the laps counted
+      // don't depend on how soon this sees it. Laps they logged before it are processed first.
+      if (currentTime[0] > 0) break;
+      raceTimeUp = true;
+      if (!TimedLapsDone()) break;
+      // Every lane's finish, and the end of the race, are posted together.
+      if (RaceEventsFree() >= laneCount + 2) {
+        // Turn off all lap trigger interrupts.
+        EnablePinInterrupts(false);
+        raceDeadlineOn = false;
+        UpdateLeaderBoard();
+        for(byte i = 1; i <= laneCount; i++){
+          if(laneEnableStatus[i] == Active){
+            // Set lanes to finished state, their places are written to the LEDs.
+            laneEnableStatus[i] = Finished;
+            RacePost(EvFinished, i, 0, 0);
+          }
+        }
+        finishedCount = laneCount;
+        RacePost(EvTimeUp, leaderBoard[0][1], 0, 0);
+        RacePost(EvRaceOver, 0, 0, 0);
+        raceOverPosted = true;
+      }
+    } // END Timed race case
+    break;
+    default:
+    break;
+  } // END RaceType Switch (Finishing Check)
+
+  // Publish the snapshot for the UI context.
+  raceSnap.nowMillis = curMillis;
+  raceSnap.elapsed = curMillis - startMillis[0];
+  raceSnap.clock = currentTime[0];
+  for (byte i = 1; i <= laneCount; i++) {
+    raceSnap.laneTime[i] = currentTime[i];
+    raceSnap.laps[i] = lapCount[i];
+    raceSnap.status[i] = laneEnableStatus[i];
+  }
+}
+
+// UI context set up, on entering the Race state.
+void RaceUiBegin(){
+  if (!DragRace()) {
+    lcd.clear();
+    PrintLeaderBoard(!newRace);
+  }
+  // Cycle through possible lanes and write start notification to racer displays.
+  for(byte i = 1; i <= laneCount; i++){
+    if(laneEnableStatus[i] == StandBy){
+      PrintText(Start, displays(i), 7, 8, true, 0, true);
+    } else if(laneEnableStatus[i] == Off){
+      PrintText(RacerName(0), displays(i), 7, 8, true, 0, true);
+    }
+    // Return each racer's display to their running lap time.
+    flashHold[i] = false;
+    Bleep();
+  }
+  // Reset display tick timestamp to current loop's timestamp.
+  lastTickMillis = millis();
+}
+
+// Shows an event posted by the timing context.
+void RaceUiEvent(raceEvents type, byte lane, int data, unsigned long time){
+  unsigned long now = raceSnap.nowMillis;
+  switch (type) {
+    case EvGreen: {
+      // Turn on MAX7219 start light tree - green LEDs
+      // The start tree is lit first as it's the quickest to update.
+      lc.clearDisplay(laneCount);
+      lc.setLed(laneCount, 0, 6, true);
+      lc.setLed(laneCount, 1, 6, true);
+      // Turn adafruit start light to green
+      setBargraph(LED_GREEN);
+      if (DragRace()) {
+        // for drag race, update LCD
+        lcd.setCursor(0, 2);
+        lcd.print(F("Go! Go! Go! Go! Go! "));
+      }
+      // reset ledCountdownTemp to default for next race
+      ledCountdownTemp = 0;
+    }
+    break;
+    case EvSector: {
+      // A lap flash takes priority, and once the lap is over its split is only logged.
+      if (flashHold[lane]) break;
+      PrintSectorDelta(lane, data, time, bestSectorMillis[lane][data - 1]);
+      flashStartMillis[lane] = now;
+      flashHold[lane] = true;
+    }
+    break;
+    case EvLap: {
+      // Update the racer's LED with the completed lap # and laptime.
+      lc.clearDisplay( displays(lane) - 1 );
+      // print the just completed lap # to left side of racer's  LED
+      PrintNumbers(data, 3, 2, displays(lane));
+      // print the lap time of just completed lap to right side of racer's LED
+      PrintClock(time, 7, 4, 3, displays(lane));
+      flashStartMillis[lane] = now;
+      flashHold[lane] = true;
+      // The leader board is redrawn once the events of this loop have been shown.
+      raceLcdDue = true;
+    }
+    break;
+    case EvFinished: {
+      // Update the racer's LED display with their finishing place.
+      switch (raceType) {
+        #if BUILD_DRAG
+        case Drag: {
+          PrintClock(time, 7, 5, 3, displays(lane), 0);
+          // For a Drag Race, light up LED of each lane in 1st place, both on a tie.
+          // A lane timed by a linked slave can be re-posted, ahead of a lane already shown, so they're redrawn.
+          byte winLights = 0;
+          for (byte i = 1; i <= 2; i++) {
+            if (finishPlace[i] == 1) winLights |= bit(i);
+          }
+          if (winLights != dragWinLights) {
+            dragWinLights = winLights;
+            lc.clearDisplay(laneCount);
+            setBargraph(LED_OFF);
+            for (byte i = 1; i <= 2; i++) {
+              if (!(winLights & bit(i))) continue;
+              // index (lane), will be 1 or 2, but the MAX7219 index is zero based.
+              lc.setLed(laneCount, i-1, 0, true);
+              // lane 1 should light LEDs 0-11; lane 2 should light LEDs 12-23.
+              setBargraph(LED_GREEN, i*12 - 1, (i-1)*12);
+            }
+          }
+        }
+        break;
+        #endif
+        default: {
+          UpdateNameOnLED(lane);
+          // Play finishing song of finishing racer, a Timed race plays the leader's song once time is up.
+          if (data > 0) PlayVictorySong(SONGS_BY_PLACE ? data : RacerSong(laneRacer[lane]));
+        }
+        break;
+      }
+    }
+    break;
+    case EvTimeUp: {
+      // Play finishing song of 1st place racer.
+      PlayVictorySong(SONGS_BY_PLACE ? 1 : RacerSong(laneRacer[data]));
+    }
+    break;
+    case EvRaceOver: {
+      // If all racers have completed all laps, transition to Finished state.
+      ChangeStateTo(Finish);
+    }
+    break;
+    default:
+    break;
+  }
+}
+
+// Shows the events posted by the timing context, and refreshes the race clocks from its snapshot.
+void RaceUiStep(){
+  unsigned long now = raceSnap.nowMillis;
+  for (byte n = 0; n < raceUiBurst && raceEventTail != raceEventHead; n++) {
+    RaceEvent &ev = raceEventQ[raceEventTail];
+    RaceUiEvent(ev.type, ev.lane, ev.data, ev.time);
+    raceEventTail = (raceEventTail + 1) % raceEventQSize;
+    if (state != Race) return;
+  }
+  if (raceLcdDue) {
+    raceLcdDue = false;
+    UpdateLiveRaceLCD();
+  }
+
+  // ********* LIVE RACE **********
+  // For Circuit Racing, after 2sec (ie 2000ms), turn start lights off.
+  if(clearStartLight && !DragRace()){
+    if (raceSnap.elapsed >= START_LIGHT_OFF_DELAY) {
+      // clear Adafruit Bargraph
+      setBargraph(LED_OFF);
+      clearStartLight = false;
+      // clear MAX7219 start light tree
+      lc.clearDisplay(laneCount);
+    }
+  }
+
+  bool tick = (now - lastTickMillis > displayTick);
+  for(byte i = 1; i <= laneCount; i++){
+    if (raceSnap.status[i] != Active) continue;
+    // if flash time is up, end display of the last lap
+    if (flashHold[i]) {
+      if (now - flashStartMillis[i] > flashDisplayTime) flashHold[i] = false;
+      continue;
+    }
+    // update running laptime to LED displays
+    #if DISPLAY_COPROC == 1
+      // The coprocessor runs the lap clock itself, so it's only sent when it needs starting.
+      if (!coprocClockRunning[i - 1]){
+        PrintNumbers(raceSnap.laps[i], 3, 2, displays(i));
+        CoprocClockRun(i - 1, raceSnap.laneTime[i], 7, 5, 1);
+      }
+    #else
+      if (tick){
+        PrintNumbers(raceSnap.laps[i], 3, 2, displays(i));
+        PrintClock(raceSnap.laneTime[i], 7, 5, 1, displays(i), 0);
+      }
+    #endif
+  }
+
+  // If a tick has passed then update displays.
+  if (tick){
+    // Update the main LCD
+    // The race clock is refreshed every tick, so it's dropped before lap updates if the I2C queue is filling up.
+    if (!DragRace()) {
+      SetTwiPriority(TwiLow);
+      PrintClock(raceSnap.clock, RACE_CLK_POS, 10, 1, lcdDisp, 0, true);
+      SetTwiPriority(TwiNormal);
+      // Swap the live leader board between gaps and intervals.
+      if (LIVE_GAPS && LIVE_GAPS_SWAP_MS > 0 && now - gapSwapMillis > LIVE_GAPS_SWAP_MS) {
+        gapSwapMillis = now;
+        gapShowInterval = !gapShowInterval;
+        PrintLiveGaps();
+      }
+    }
+    lastTickMillis = now;
+  }
+}
+
+
 // This function updates all the Racer names on the LEDS according to lane status.
 void UpdateAllNamesOnLEDs(){
   for (byte i = 1; i <= laneCount; i++){
@@ -2933,29 +6706,30 @@ void UpdateAllNamesOnLEDs(){
 void UpdateNameOnLED(byte lane){
   // if the lane is 'Finished' then check place
   if(laneEnableStatus[lane] == Finished){
-    // Find what place the racer is in
-    for(byte i = 1; i <= laneCount; i++){
-      // If the racer has finished then write their place then name.
-      if(leaderBoard[i-1][1] == lane){
-        // remember strings have an end string character so "DEF" is a 4 element char array.
-        char finishPlace[] = "DEF";
-        // Get place text prefix string
-        strcpy_P(finishPlace, (char*)pgm_read_word(&(FinishPlaceText[i])));
-        PrintText(finishPlace, displays(lane), 2, 3, false, 0, false);
-        PrintText(Racers[laneRacer[lane]], displays(lane), 7, 4, false, 0, true);
-        // Serial.print("Finished plce LED: ");
-        // Serial.println(finishPlace);
-      }
-      // If the racer has not finished don't do anything.
+    // Find what place the racer is in, a Timed race's places are only on the leader board.
+    byte place = finishPlace[lane];
+    for(byte i = 1; i <= laneCount && place == 0; i++){
+      if(leaderBoard[i-1][1] == lane) place = i;
+    }
+    // If the racer has finished then write their place then name.
+    if (place > 0) {
+      // remember strings have an end string character so "DEF" is a 4 element char array.
+      char placeText[] = "DEF";
+      // Get place text prefix string
+      strcpy_P(placeText, (char*)pgm_read_word(&(FinishPlaceText[place])));
+      PrintText(placeText, displays(lane), 2, 3, false, 0, false);
+      // A place shared with a racer who crossed at the same time is marked with an '='.
+      PrintText(finishTie[lane] ? "=" : " ", displays(lane), 3, 1, false, 0, false);
+      PrintText(RacerName(laneRacer[lane]), displays(lane), 7, 4, false, 0, true);
     }
   } else
   // else if lane is in StandBy just print the name
   if(laneEnableStatus[lane] == StandBy){
-    PrintText(Racers[laneRacer[lane]], displays(lane), 7, 8);
+    PrintText(RacerName(laneRacer[lane]), displays(lane), 7, 8);
   } else
-  // else if lane is Off, print label held in resreve idx, Racers[0].
+  // else if lane is Off, print label held in resreve idx, RacerName(0).
   if(laneEnableStatus[lane] == Off){
-    PrintText(Racers[laneRacer[0]], displays(lane), 7, 8);
+    PrintText(RacerName(laneRacer[0]), displays(lane), 7, 8);
   }
 } // END UpdateNameOnLED()
 
@@ -2996,7 +6770,10 @@ int EditNumber(int digits, int maxValue, int line, int cursorPos){
   lcd.setCursor(cursorPos, line);
 
   while (!done){
-    keyIN = keypad.getKey();
+    #if WATCHDOG
+      wdt_reset();
+    #endif
+    keyIN = GetKey();
     switch (keyIN) {
       case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9': case '0': {
         Beep();
@@ -0,0 +1,42 @@
+// 7-segment font for the MAX7219 LED bars, written with raw segment writes, 'lc.setRow()'.
+// Each byte is the segments lit for that ASCII character: bit 7 = DP, then segments A B C D E F G.
+//     A
+//   F   B
+//     G
+//   E   C
+//     D   DP
+// Like LedControl's own table, 0-15 are the hex digits, so a digit value can be written as a character.
+// Letters that don't fit on 7 segments (K, M, V, W, X) are the closest readable shape,
+// and upper and lower case letters only differ where both can be drawn.
+const byte segmentFont[128] PROGMEM = {
+  // 0-15, hex digits
+  0b01111110, 0b00110000, 0b01101101, 0b01111001, 0b00110011, 0b01011011, 0b01011111, 0b01110000,
+  0b01111111, 0b01111011, 0b01110111, 0b00011111, 0b01001110, 0b00111101, 0b01001111, 0b01000111,
+  // 16-31, unused
+  0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0,
+  //  ' '         !           "           #           $           %           &           '
+  0b00000000, 0b10110000, 0b00100010, 0b00110111, 0b01011011, 0b00100101, 0b01111101, 0b00000010,
+  //  (           )           *           +           ,           -           .           /
+  0b01001110, 0b01111000, 0b01100011, 0b00000111, 0b10000000, 0b00000001, 0b10000000, 0b00100101,
+  //  0           1           2           3           4           5           6           7
+  0b01111110, 0b00110000, 0b01101101, 0b01111001, 0b00110011, 0b01011011, 0b01011111, 0b01110000,
+  //  8           9           :           ;           <           =           >           ?
+  0b01111111, 0b01111011, 0b01001000, 0b10001001, 0b00001101, 0b00001001, 0b00011001, 0b01100101,
+  //  @           A           B           C           D           E           F           G
+  0b01111101, 0b01110111, 0b00011111, 0b01001110, 0b00111101, 0b01001111, 0b01000111, 0b01011110,
+  //  H           I           J           K           L           M           N           O
+  0b00110111, 0b00000110, 0b00111100, 0b01010111, 0b00001110, 0b01010101, 0b01110110, 0b01111110,
+  //  P           Q           R           S           T           U           V           W
+  0b01100111, 0b01110011, 0b00000101, 0b01011011, 0b00001111, 0b00111110, 0b00111010, 0b00101010,
+  //  X           Y           Z           [           \           ]           ^           _
+  0b00110111, 0b00111011, 0b01101101, 0b01001110, 0b00010011, 0b01111000, 0b01100010, 0b00001000,
+  //  `           a           b           c           d           e           f           g
+  0b00100000, 0b01111101, 0b00011111, 0b00001101, 0b00111101, 0b01101111, 0b01000111, 0b01111011,
+  //  h           i           j           k           l           m           n           o
+  0b00010111, 0b00010000, 0b00111000, 0b01010111, 0b00000110, 0b01010101, 0b00010101, 0b00011101,
+  //  p           q           r           s           t           u           v           w
+  0b01100111, 0b01110011, 0b00000101, 0b01011011, 0b00001111, 0b00011100, 0b00111010, 0b00101010,
+  //  x           y           z           {           |           }           ~          DEL
+  0b00110111, 0b00111011, 0b01101101, 0b00110001, 0b00000110, 0b00000111, 0b01000000, 0b00000000
+};
@@ -25,6 +25,39 @@
 // *** default #defines in case not Set by localSettings ***
 // *********************************************************
 
+// *** BUILD PROFILE ***
+// A Nano's flash and SRAM are nearly full, so subsystems that aren't used can be compiled out.
+// Pick a profile with BUILD_PROFILE, or set the BUILD_ flags below one at a time, which override the profile.
+// The freed SRAM can go to a longer fastest laps list, DEFAULT_MAX_STORED_LAPS.
+#define PROFILE_FULL 0
+// Standard & Timed races only, no drag racing.
+#define PROFILE_CIRCUIT_ONLY 1
+// Drag racing only. Only each lane's 1 drag time is kept, so DEFAULT_MAX_STORED_LAPS defaults to 1.
+#define PROFILE_DRAG_ONLY 2
+// No songs or beeps, the RTTTL player and songs are left out.
+#define PROFILE_NO_AUDIO 3
+// No Adafruit bargraph start light, the MAX7219 start light tree only.
+#define PROFILE_NO_BARGRAPH 4
+#if !defined ( BUILD_PROFILE )
+  #define BUILD_PROFILE PROFILE_FULL
+#endif
+// Standard & Timed lap races.
+#if !defined ( BUILD_CIRCUIT )
+  #define BUILD_CIRCUIT (BUILD_PROFILE != PROFILE_DRAG_ONLY)
+#endif
+// Drag races.
+#if !defined ( BUILD_DRAG )
+  #define BUILD_DRAG (BUILD_PROFILE != PROFILE_CIRCUIT_ONLY)
+#endif
+// The buzzer's songs and beeps.
+#if !defined ( BUILD_AUDIO )
+  #define BUILD_AUDIO (BUILD_PROFILE != PROFILE_NO_AUDIO)
+#endif
+// The Adafruit 24 LED bargraph start light.
+#if !defined ( BUILD_BARGRAPH )
+  #define BUILD_BARGRAPH (BUILD_PROFILE != PROFILE_NO_BARGRAPH)
+#endif
+
 
 // Number of physical lanes available for the system (max of 4 allowed)
 // Fewer lanes will support a higher number of DEFAULT_MAX_STORED_LAPS
@@ -38,7 +71,7 @@
 // if this gets too large the system will run out of memory and crash
 // recommended max is 20 if LANE_COUNT = 2, 15 if LANE_COUNT = 3, and 10 if LANE_COUNT = 4
 #if !defined ( DEFAULT_MAX_STORED_LAPS )
-  #define DEFAULT_MAX_STORED_LAPS 20
+  #define DEFAULT_MAX_STORED_LAPS (BUILD_CIRCUIT ? 20 : 1)
 #endif
 
 // Drag Race lap triggers
@@ -123,6 +156,23 @@
   #define LANE4 {PIN_A3, 0b00001000}
 #endif
 
+// Optional sector sensor of each lane, as a pin and interrupt byte mask pair.
+// A sector sensor must be on a spare pin of the INTERRUPT_PORT used by the lanes.
+// On a Nano, A4 & A5 are used by I2C, so only lanes 1 & 2 can have sectors, using A2 & A3.
+// {255, 0} means the lane has no sector sensor.
+#if !defined ( LANE1_SECTOR )
+  #define LANE1_SECTOR {255, 0}
+#endif
+#if !defined ( LANE2_SECTOR )
+  #define LANE2_SECTOR {255, 0}
+#endif
+#if !defined ( LANE3_SECTOR )
+  #define LANE3_SECTOR {255, 0}
+#endif
+#if !defined ( LANE4_SECTOR )
+  #define LANE4_SECTOR {255, 0}
+#endif
+
 // Interrupt Hardware (ONLY CHANGE if using a non-Nano based Arduino)
 // For ATmega328 based Arduino use 'PCINT1_vect', case sensitive, no quotes
 // For ATmega2560 based Arduino use 'PCINT2_vect', case sensitive, no quotes
@@ -291,7 +341,11 @@
 #endif
 
 #if !defined( START_RACE_3RD_ROW )
-  #define START_RACE_3RD_ROW "C|Drag Race"
+  #if BUILD_DRAG
+    #define START_RACE_3RD_ROW "C|Drag Race"
+  #else
+    #define START_RACE_3RD_ROW ""
+  #endif
 #endif
 // Set the end position of the countdown number
 // Should be chosen to align countdown value with D_START_RACE_COUNTDOWN text.
@@ -355,6 +409,26 @@
   #define RESULTS_TOP_TEXT_LAP "Lap"
 #endif
 
+// Show the gap to the leader, and interval to the car ahead, on the live leader board, in place of the best lap.
+#if !defined( LIVE_GAPS )
+  #define LIVE_GAPS true
+#endif
+// ms between swapping the live leader board from gaps to intervals, and back. 0 only shows gaps.
+#if !defined( LIVE_GAPS_SWAP_MS )
+  #define LIVE_GAPS_SWAP_MS 4000
+#endif
+// text used to label the gap, and interval, columns of the live leader board, max 5ch
+#if !defined( LIVE_GAP_TEXT )
+  #define LIVE_GAP_TEXT "Gap"
+#endif
+#if !defined( LIVE_INT_TEXT )
+  #define LIVE_INT_TEXT "Int"
+#endif
+// text shown in place of the race leader's gap, max 6ch
+#if !defined( LIVE_LEAD_TEXT )
+  #define LIVE_LEAD_TEXT "Leader"
+#endif
+
 // Blink rate between Racer#ID and Racer Name on individual results screen.
 #if !defined( RESULTS_RACER_BLINK )
   #define RESULTS_RACER_BLINK 2000
@@ -412,6 +486,11 @@
 #if !defined ( RACER_NAMES_LIST )
   #define RACER_NAMES_LIST {TEXT_OFF, "Lucien", "Zoe", "Elise", "John", "Angie", "Uncle 1", "Rat2020_longer", "The OG", "5318008"}
 #endif
+// Longest racer name allowed in RACER_NAMES_LIST.
+// Names are stored in flash at this fixed length, so a longer name is a compile error.
+#if !defined ( RACER_NAME_CHARS )
+  #define RACER_NAME_CHARS 14
+#endif
 // If SONG_BY_PLACE is 'false', songs are associated with racer name of matching array index
 // songs to choose from are defined in the RTTL_songs.h file
 // If SONG_BY_PLACE is 'false', the number of terms should match the # of terms in 'RACER_NAMES_LIST"
@@ -427,5 +506,292 @@
 #if !defined ( SONGS_BY_PLACE )
   #define SONGS_BY_PLACE false
 #endif
-
-
+// RACER_SONG_IDS is optional and not defined by default.
+// When set, it holds an index into RACER_SONGS_LIST for each name of RACER_NAMES_LIST,
+// so a large roster can share a short list of songs, ie. {0, 3, 1, 1, 2, ...}.
+// When not set, a racer plays the song of the same index, wrapping around a shorter song list.
+// On the Select Racers menu, digit keys typed within this many ms of each other build a T9 style
+// name prefix, ie. '5' '6' jumps to the first free name starting with 'Jo', 'Ko', 'Lo', etc.
+#if !defined ( RACER_T9_TIMEOUT )
+  #define RACER_T9_TIMEOUT 3000
+#endif
+
+
+
+
+// TOURNAMENT HEATS
+// Number of racers, counting from index 1 of RACER_NAMES_LIST, that make up the tournament roster.
+// Set to 0 to use the entire racer names list.
+#if !defined ( TOURNEY_ROSTER_SIZE )
+  #define TOURNEY_ROSTER_SIZE 0
+#endif
+// Points awarded for each finishing place of a tournament heat.
+// The 1st term is for a DNF, then 1st, 2nd, 3rd, and 4th place.
+#if !defined ( TOURNEY_POINTS )
+  #define TOURNEY_POINTS {0, 4, 3, 2, 1}
+#endif
+// text displayed on top row of the tournament standings results page
+#if !defined( RESULTS_STANDINGS_LBL )
+  #define RESULTS_STANDINGS_LBL "C| STANDINGS"
+#endif
+
+// DIAGNOSTICS
+// Set to true to open the serial port at 9600 baud, so the Diagnostics Menu can
+// dump its ISR and loop() latency histograms, by pressing 'B'.
+// Enabling Serial increases program memory use by about 4%.
+#if !defined ( DIAGNOSTICS_SERIAL )
+  #define DIAGNOSTICS_SERIAL false
+#endif
+
+// TRACK SIMULATOR
+// Set to true to build in the track simulator, which drives the lane sensor pins from a
+// 1kHz Timer1 interrupt as if cars were crossing them. The lane sensors must be disconnected.
+// Lap counts and finishing places are checked against the simulator at the end of each race,
+// and reported on the last page of the Diagnostics Menu.
+#if !defined ( TRACK_SIMULATOR )
+  #define TRACK_SIMULATOR false
+#endif
+// Set to true to have the simulator press the Start & Pause buttons, running races back to back.
+// Only the 1st race needs to be started from the menus.
+#if !defined ( SIM_SOAK )
+  #define SIM_SOAK false
+#endif
+// Mean simulated lap time, and the max random variation either side of it, in ms.
+// The lap time will never be less than the DEBOUNCE time.
+#if !defined ( SIM_LAP_MS )
+  #define SIM_LAP_MS 1200
+#endif
+#if !defined ( SIM_LAP_JITTER_MS )
+  #define SIM_LAP_JITTER_MS 600
+#endif
+// Max random time, in ms, a simulated car takes to cross the start after the green.
+#if !defined ( SIM_REACTION_MS )
+  #define SIM_REACTION_MS 400
+#endif
+// Length in ms, of each simulated sensor pulse, max 255.
+#if !defined ( SIM_PULSE_MS )
+  #define SIM_PULSE_MS 3
+#endif
+
+// KEYPAD
+// Set to true to scan the keypad from a pin change interrupt on its columns, instead of every loop().
+// The keypad column pins must all be on port B (pins 8-13 on a Nano).
+// Only on by default on an ATmega328P (Nano/Uno). On an ATmega2560 (Mega) the default column pin 9 has no pin change
+// interrupt, so the keypad would never respond.
+#if !defined ( KEYPAD_INTERRUPTS )
+  #if defined ( __AVR_ATmega328P__ )
+    #define KEYPAD_INTERRUPTS true
+  #else
+    #define KEYPAD_INTERRUPTS false
+  #endif
+#endif
+
+// I2C DISPLAYS
+// Set to true to send the LCD and Adafruit bargraph writes from a queue, by the I2C (TWI) interrupt,
+// so display updates return without waiting on the bus. Left false, the hd44780 and Adafruit libraries are used,
+// which block loop() for each write, but auto-detect the LCD backpack's address and wiring.
+// The queued LCD driver doesn't detect them, it assumes LCD_I2C_ADDRESS, and the common PCF8574 backpack wiring,
+// P0-P3 = RS, RW, E, Backlight, P4-P7 = D4-D7.
+#if !defined ( I2C_ASYNC )
+  #define I2C_ASYNC false
+#endif
+// I2C address of the LCD backpack, only used if I2C_ASYNC is true, often 0x27 or 0x3F.
+#if !defined ( LCD_I2C_ADDRESS )
+  #define LCD_I2C_ADDRESS 0x27
+#endif
+// I2C bus clock in Hz, only used if I2C_ASYNC is true.
+// The PCF8574 is only rated for 100kHz, but most backpacks run fine at 400kHz, which is worth trying once the LCD works.
+#if !defined ( I2C_CLOCK )
+  #define I2C_CLOCK 100000
+#endif
+// # of bytes in the I2C transmit queue, max 255. Each LCD character uses 1 byte, and a cursor move 2.
+#if !defined ( I2C_QUEUE_SIZE )
+  #define I2C_QUEUE_SIZE 128
+#endif
+
+// LINKED CONTROLLERS
+// Two or more controllers can time one race, linked over their serial (UART) pins.
+// The master runs the race, the others (slaves) only timestamp their lane sensors, and send them to the master.
+// The master keeps each slave's clock synchronized to its own, so all the lanes are timed on one clock.
+// 0 = not linked, 1 = master, 2 or more = slave, each slave must have its own #.
+// While linked, the USB serial port can't be used, so DIAGNOSTICS_SERIAL must be false.
+#if !defined ( LINK_NODE )
+  #define LINK_NODE 0
+#endif
+// Total # of linked controllers, including the master. Only used by the master.
+#if !defined ( LINK_NODES )
+  #define LINK_NODES 2
+#endif
+// Link baud rate, 250000 is exact with a 16MHz clock. Must be the same on every controller.
+#if !defined ( LINK_BAUD )
+  #define LINK_BAUD 250000
+#endif
+// ms between the master's polls, each poll goes to the next slave in turn.
+#if !defined ( LINK_POLL_MS )
+  #define LINK_POLL_MS 10
+#endif
+// Master only. Bit mask of the master's lanes that are timed by a slave's sensors, bit 0 is lane 1.
+// ex. 0b1100, lanes 3 & 4 are timed by a slave. Their sensor pins on the master are ignored.
+#if !defined ( LINK_REMOTE_LANES )
+  #define LINK_REMOTE_LANES 0
+#endif
+// Slave only. The master's lane # that the slave's lane 1 sensor is timing.
+// ex. 3, the slave's lane 1 & 2 sensors time the master's lanes 3 & 4.
+#if !defined ( LINK_FIRST_LANE )
+  #define LINK_FIRST_LANE 1
+#endif
+
+// *** SD CARD RACE ARCHIVE ***
+// Every race's laps, faults, and state changes are logged to an SD card, written to as raw 512 byte blocks.
+// The SD card is wired to the SPI pins, which on a Nano are used by the keypad and buzzer,
+// so the archive can only be used on a Mega2560. Any file system on the card is overwritten.
+#if !defined ( SD_ARCHIVE )
+  #define SD_ARCHIVE false
+#endif
+// SD card chip select pin. 53 is the Mega's hardware SS pin.
+#if !defined ( SD_CS_PIN )
+  #define SD_CS_PIN 53
+#endif
+// 1st block of the archive, it holds the race index. The race records start in the block after it.
+#if !defined ( SD_ARCHIVE_FIRST_BLOCK )
+  #define SD_ARCHIVE_FIRST_BLOCK 0
+#endif
+// # of 512 byte blocks used for race records. When full, it wraps back to the start, over the oldest races.
+#if !defined ( SD_ARCHIVE_BLOCKS )
+  #define SD_ARCHIVE_BLOCKS 65536
+#endif
+
+// *** LANE LED NAME MARQUEE ***
+// Racer names too long for their space on a lane LED are scrolled through it.
+// ms between each scroll step.
+#if !defined ( MARQUEE_STEP_MS )
+  #define MARQUEE_STEP_MS 350
+#endif
+// Max # of characters of a name that are scrolled, the rest are cut off. Each lane uses this many bytes of RAM.
+#if !defined ( MARQUEE_CHARS )
+  #define MARQUEE_CHARS 16
+#endif
+
+// *** IDLE POWER MANAGER ***
+// Sleep the controller between interrupts while in the menus, or on the finish screen, to save power.
+#if !defined ( IDLE_SLEEP )
+  #define IDLE_SLEEP true
+#endif
+// ms in the menus, without a key or button press, before the controller goes into its deepest sleep,
+// waking every ~64ms to check the buttons. 0 = never. Needs KEYPAD_INTERRUPTS.
+#if !defined ( IDLE_POWER_DOWN_MS )
+  #define IDLE_POWER_DOWN_MS 30000
+#endif
+
+// *** RACE CHECKPOINT ***
+// A live race is saved to EEPROM as it runs, so if the controller is reset mid race, by a brownout or the watchdog,
+// it starts back up in the race, paused.
+#if !defined ( RACE_CHECKPOINT )
+  #define RACE_CHECKPOINT BUILD_CIRCUIT
+#endif
+// Min ms between checkpoints, taken when laps have been logged since the last.
+#if !defined ( CHECKPOINT_MS )
+  #define CHECKPOINT_MS 1000
+#endif
+// ms between checkpoints when no laps have been logged, to save the race clock.
+#if !defined ( CHECKPOINT_CLOCK_MS )
+  #define CHECKPOINT_CLOCK_MS 10000
+#endif
+// # of EEPROM slots the checkpoints are written to in turn, min 2. Each is ~60 bytes with 2 lanes, ~100 with 4.
+// An EEPROM byte is rated for ~100,000 writes, and a checkpoint's sequence #, clock, and CRC change every time,
+// so each slot lasts ~100,000 * CHECKPOINT_SLOTS * CHECKPOINT_MS of racing, ~220 hours with 8 slots every 1000ms.
+#if !defined ( CHECKPOINT_SLOTS )
+  #define CHECKPOINT_SLOTS 8
+#endif
+// 1st EEPROM address of the checkpoint slots.
+#if !defined ( CHECKPOINT_EEPROM_ADDR )
+  #define CHECKPOINT_EEPROM_ADDR 0
+#endif
+
+// *** WATCHDOG ***
+// Resets the controller if loop() stops running for WATCHDOG_TIMEOUT, such as from a locked up I2C bus.
+// Set to true only on a board with the new (Optiboot) bootloader. The old Nano bootloader doesn't turn the watchdog off
+// after a reset, so the controller would keep resetting.
+#if !defined ( WATCHDOG )
+  #define WATCHDOG false
+#endif
+// One of the avr/wdt.h timeouts, WDTO_15MS to WDTO_8S.
+#if !defined ( WATCHDOG_TIMEOUT )
+  #define WATCHDOG_TIMEOUT WDTO_2S
+#endif
+
+// *** BUS ACCOUNTING ***
+// Count the bytes written to the I2C (LCD & bargraph) and LED buses in each state, and estimate their time on the wire.
+// Shown on a Diagnostics Menu page, and dumped to serial with the latency histograms. Uses ~200 bytes of RAM.
+// I2C is only counted with I2C_ASYNC. Without it the hd44780 and Adafruit libraries write to Wire themselves,
+// so the I2C figures are 0, and only the LED bus is counted.
+#if !defined ( BUS_ACCOUNTING )
+  #define BUS_ACCOUNTING false
+#endif
+// Estimated us to shift 1 byte out to the MAX7219 chain. LedControl bit bangs it with digitalWrite(), ~80us on a 16MHz board.
+#if !defined ( BUS_LED_BYTE_US )
+  #define BUS_LED_BYTE_US 80
+#endif
+// Max estimated ms of bus time per second in the Race state. Flagged 'OVER' when it's passed, 0 = no budget.
+// A simulated race over it fails a SIM_SOAK test, which stops at that race's Finish.
+// 50 fits the default simulated race, 2 lanes with I2C_ASYNC off: a lap flash is ~14 LED writes, and a running
+// lap clock ~3 writes a tick, to a 3 chip chain, ~40ms/s at most. Raise it for more lanes, or with I2C_ASYNC on,
+// from the figure of a known good build running the same simulated races.
+#if !defined ( BUS_BUDGET_RACE )
+  #define BUS_BUDGET_RACE 50
+#endif
+
+// *** SEASON STANDINGS ***
+// Running points, wins, best lap, and average lap of each racer across races, kept in EEPROM,
+// and shown sorted on a Season page of the Results Menu.
+#if !defined ( SEASON_STANDINGS )
+  #define SEASON_STANDINGS true
+#endif
+// Points awarded for each finishing place of a race. The 1st term is for a DNF, then 1st, 2nd, 3rd, and 4th place.
+#if !defined ( SEASON_POINTS )
+  #define SEASON_POINTS TOURNEY_POINTS
+#endif
+// Number of racers, counting from index 1 of RACER_NAMES_LIST, kept in the season.
+// Each takes 15 bytes of EEPROM. Set to 0 to keep as many as fit.
+#if !defined ( SEASON_ROSTER_SIZE )
+  #define SEASON_ROSTER_SIZE 0
+#endif
+// 1st EEPROM address of the season. -1 puts it right after the race checkpoint.
+#if !defined ( SEASON_EEPROM_ADDR )
+  #define SEASON_EEPROM_ADDR -1
+#endif
+// text displayed on top row of the season standings results page, max 9 characters
+#if !defined( RESULTS_SEASON_LBL )
+  #define RESULTS_SEASON_LBL "D|SEASON"
+#endif
+
+// *** DISPLAY COPROCESSOR ***
+// Moves the lane LED bars, start light, and bargraph to a 2nd board, sent commands over the UART,
+// so this controller doesn't spend race time on their bus writes. Both boards run this sketch.
+// 0 = off, the displays are driven here
+// 1 = this board is the race controller, its UART TX pin is wired to the coprocessor's RX pin
+// 2 = this board is the coprocessor, with the LED bars and bargraph wired to it
+// 3 = this board is a test coprocessor, that prints the displays to the serial terminal
+#if !defined ( DISPLAY_COPROC )
+  #define DISPLAY_COPROC 0
+#endif
+// UART speed of the link, the same on both boards.
+#if !defined ( COPROC_BAUD )
+  #define COPROC_BAUD 500000
+#endif
+// ms between redraws of a running lap clock on the coprocessor.
+#if !defined ( COPROC_CLOCK_MS )
+  #define COPROC_CLOCK_MS 50
+#endif
+
+// *** TIMED RACE FINISH ***
+// A Timed race ends exactly on its set time, lap crossings after it aren't counted.
+// With FINISH_CURRENT_LAP true, each racer's next crossing after the time is up still finishes the lap they were on,
+// and racers are placed by how far round that lap they were when time ran out, worked out from its crossing times.
+#if !defined ( FINISH_CURRENT_LAP )
+  #define FINISH_CURRENT_LAP false
+#endif
+// Max ms, after time is up, to wait for racers to finish the lap they were on. A lap not finished by then isn't counted.
+#if !defined ( FINISH_LAP_TIMEOUT )
+  #define FINISH_LAP_TIMEOUT 30000
+#endif
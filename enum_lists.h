@@ -64,7 +64,8 @@ typedef enum: uint8_t {
     SettingsMenu,
     SelectRacersMenu,
     StartRaceMenu,
-    ResultsMenu
+    ResultsMenu,
+    DiagnosticsMenu
 } Menus;
 
 
@@ -75,3 +76,67 @@ typedef enum: uint8_t {
   Mute
 } audioModes;
 
+
+
+// Tournament options, set from the 'Start a Race' menu.
+typedef enum: uint8_t {
+  NoTourney,    // single race, results menu shown at finish
+  RoundRobin,   // racers rotate through every lane, points decide the standings
+  Elimination   // last place in each heat is knocked out until 1 racer remains
+} tourneyModes;
+
+
+// Priority of a display write, sent through the I2C transmit queue.
+typedef enum: uint8_t {
+  TwiNormal,  // always queued, waits for room if the queue is full
+  TwiLow      // dropped if the queue is filling up, ex. a clock refresh that the next tick will redo
+} twiPriority;
+
+
+// Frame types sent between linked controllers.
+typedef enum: uint8_t {
+  LinkPoll = 1,   // master to slave, asks for its lap events, and acknowledges the last reply
+  LinkReply = 2   // slave to master, the poll's timestamps, and any new lap events
+} linkFrames;
+
+// Record types in the SD card race archive.
+typedef enum: uint8_t {
+  ArchPad = 0,        // unused space at the end of a block
+  ArchRaceStart = 1,  // lane = raceType, data = race laps, time = race set time in ms
+  ArchState = 2,      // lane = new state, time = millis()
+  ArchLap = 3,        // lane = lane #, data = lap #, time = lap time in ms
+  ArchFault = 4,      // lane = faulting lane #, time = drag red light ms early, or 0
+  ArchRaceEnd = 5     // lane = # of lanes finished, data = records dropped, time = race time in ms
+} archiveRecords;
+
+// Commands sent to a display coprocessor. 'unit' is the LED chip # in the chain.
+// Multi-byte values are LSB 1st, and positions are indexed left to right as in the display drivers.
+typedef enum: uint8_t {
+  CpLedRaw = 1,     // unit, op (a coprocLedOps LedControl call), then its 3 args, a, b, c
+  CpSpan = 2,       // unit, start, end, char
+  CpText = 3,       // unit, end, width, flags (bit 0 right justify, bit 1 clear), text chars
+  CpNumber = 4,     // unit, number (4 bytes), width, end, flags (bit 0 leading zeros, bit 1 end with decimal)
+  CpClock = 5,      // unit, time in ms (4 bytes), end, width, precision, leading zeros
+  CpClockRun = 6,   // unit, ms already elapsed (4 bytes), end, width, precision, the clock then runs on its own
+  CpBar = 7         // color, end LED, start LED, as for setBargraph()
+} coprocCmds;
+
+// LedControl calls sent in a CpLedRaw command, and the args each uses.
+typedef enum: uint8_t {
+  CpLedShutdown = 0,  // a = status
+  CpLedIntensity = 1, // a = intensity
+  CpLedClear = 2,
+  CpLedSet = 3,       // a = row, b = col, c = state
+  CpLedRow = 4,       // a = row (digit), b = segments
+  CpLedDigit = 5      // a = digit, b = value, c = dp
+} coprocLedOps;
+
+// Events the Race state's timing context posts to its UI context, see RaceTimingStep().
+typedef enum: uint8_t {
+  EvGreen = 1,    // the start lights have gone green
+  EvLap = 2,      // lane = lane #, data = completed lap #, time = lap time in ms
+  EvSector = 3,   // lane = lane #, data = sector #, time = split in ms
+  EvFinished = 4, // lane = lane #, data = finishing place (0 = time ran out), time = drag ET in ms
+  EvTimeUp = 5,   // data = lane # of the leader, a Timed race's clock has run out
+  EvRaceOver = 6  // every racer has finished
+} raceEvents;
@@ -29,6 +29,15 @@
 // ucomment and edit to customize general settings
 
 
+// // BUILD PROFILE
+// // Compile out unused subsystems to free flash and SRAM. PROFILE_FULL, PROFILE_CIRCUIT_ONLY, PROFILE_DRAG_ONLY,
+// // PROFILE_NO_AUDIO, or PROFILE_NO_BARGRAPH. The BUILD_ flags can also be set one at a time.
+// #define BUILD_PROFILE PROFILE_CIRCUIT_ONLY
+// #define BUILD_CIRCUIT true
+// #define BUILD_DRAG false
+// #define BUILD_AUDIO true
+// #define BUILD_BARGRAPH false
+
 // // Number of physical lanes available for the system (max of 4 allowed)
 // // Fewer lanes will support a higher number of DEFAULT_MAX_STORED_LAPS
 // // Lane count also defines the number of LED racer displays wired
@@ -96,6 +105,11 @@
 // #define LANE3 {PIN_A2, 0b00000100}
 // #define LANE4 {PIN_A3, 0b00001000}
 
+// // Optional lane sector sensors, on spare pins of the lanes' interrupt port.
+// // With LANE_COUNT 2 on a Nano, A2 & A3 are free to be used as sectors for lanes 1 & 2.
+// #define LANE1_SECTOR {PIN_A2, 0b00000100}
+// #define LANE2_SECTOR {PIN_A3, 0b00001000}
+
 
 // // INTERRUPT HARDWARE (ONLY CHANGE if using a non-Nano based Arduino)
 // // For ATmega328 based Arduino use 'PCINT1_vect', case sensitive, no quotes
@@ -244,6 +258,16 @@
 // #define RESULTS_TOP_TEXT_LAP "Lap"
 
 
+// // Show the gap to the leader, and interval to the car ahead, on the live leader board, in place of the best lap.
+// #define LIVE_GAPS true
+// // ms between swapping the live leader board from gaps to intervals, and back. 0 only shows gaps.
+// #define LIVE_GAPS_SWAP_MS 4000
+// // text used to label the gap, and interval, columns of the live leader board, max 5ch
+// #define LIVE_GAP_TEXT "Gap"
+// #define LIVE_INT_TEXT "Int"
+// // text shown in place of the race leader's gap, max 6ch
+// #define LIVE_LEAD_TEXT "Leader"
+
 // // Blink rate between Racer#ID and Racer Name on individual results screen.
 // #define RESULTS_RACER_BLINK 2000
 
@@ -282,6 +306,9 @@
 // // If SONG_BY_PLACE is 'false', the number of terms should match the # of terms in 'RACER_SONGS_LIST"
 // // !!!! The first term should always be 'TEXT_OFF', it is used to represent an inactive lane
 // #define RACER_NAMES_LIST {TEXT_OFF, "Lucien", "Zoe", "Elise", "John", "Angie", "Uncle 1", "Rat2020_longer", "The OG", "5318008"}
+// // Longest racer name allowed in RACER_NAMES_LIST.
+// // Names are stored in flash at this fixed length, so a longer name is a compile error.
+// #define RACER_NAME_CHARS 14
 
 // // If SONG_BY_PLACE is 'false', songs are associated with racer name of matching array index
 // // songs to choose from are defined in the RTTL_songs.h file
@@ -295,5 +322,140 @@
 // // If SONGS_BY_PLACE is 'true', 1st finisher will play RACERS_SONG_LIST[1], 2nd place finisher RACERS_SONG_LIST[2], etc.
 // // RACER_NAMES_LIST & RACERS_SONG_LIST size do not need to match if SONGS_BY_PLACE is 'true'.
 // #define SONGS_BY_PLACE true
-
-
+// // Optional victory song idx, into RACER_SONGS_LIST, for each name of RACER_NAMES_LIST.
+// // When not set, a racer plays the song of the same index, wrapping around a shorter song list.
+// #define RACER_SONG_IDS {0, 1, 2, 3, 4, 5, 6, 7, 8, 9}
+// // On the Select Racers menu, digit keys typed within this many ms of each other build a T9 style name prefix.
+// #define RACER_T9_TIMEOUT 3000
+
+
+
+
+// // TOURNAMENT HEATS
+// // Number of racers, counting from index 1 of RACER_NAMES_LIST, that make up the tournament roster.
+// // Set to 0 to use the entire racer names list.
+// #define TOURNEY_ROSTER_SIZE 6
+// // Points awarded for each finishing place of a tournament heat.
+// // The 1st term is for a DNF, then 1st, 2nd, 3rd, and 4th place.
+// #define TOURNEY_POINTS {0, 10, 6, 3, 1}
+// // text displayed on top row of the tournament standings results page
+// #define RESULTS_STANDINGS_LBL "C| STANDINGS"
+
+// // DIAGNOSTICS
+// // Set to true to open the serial port at 9600 baud, so the Diagnostics Menu can
+// // dump its ISR and loop() latency histograms, by pressing 'B'.
+// #define DIAGNOSTICS_SERIAL true
+
+// // TRACK SIMULATOR
+// // Set to true to build in the track simulator, which drives the lane sensor pins as if cars were crossing them.
+// // The lane sensors must be disconnected. The results are shown on the last page of the Diagnostics Menu.
+// #define TRACK_SIMULATOR true
+// // Set to true to have the simulator press the Start & Pause buttons, running races back to back.
+// #define SIM_SOAK true
+// // Mean simulated lap time, and the max random variation either side of it, in ms.
+// #define SIM_LAP_MS 800
+// #define SIM_LAP_JITTER_MS 200
+// // Max random time, in ms, a simulated car takes to cross the start after the green.
+// #define SIM_REACTION_MS 400
+// // Length in ms, of each simulated sensor pulse, max 255.
+// #define SIM_PULSE_MS 3
+
+// // KEYPAD
+// // Set to false to poll the keypad every loop(), instead of scanning it from a pin change interrupt.
+// // This must be false if using an ATmega2560 (Mega).
+// #define KEYPAD_INTERRUPTS false
+
+// // I2C DISPLAYS
+// // Set to true to drive the LCD and bargraph from the I2C interrupt queue, instead of the hd44780 and Adafruit libraries.
+// // Only for an LCD backpack with the common PCF8574 wiring, at LCD_I2C_ADDRESS.
+// #define I2C_ASYNC true
+// // I2C address of the LCD backpack, when I2C_ASYNC is true.
+// #define LCD_I2C_ADDRESS 0x3F
+// // I2C bus clock in Hz, when I2C_ASYNC is true. Go back to 100000 if the LCD shows garbage.
+// #define I2C_CLOCK 400000
+// // # of bytes in the I2C transmit queue, max 255.
+// #define I2C_QUEUE_SIZE 128
+
+// // LINKED CONTROLLERS
+// // 0 = not linked, 1 = master, 2 or more = slave, each slave must have its own #.
+// #define LINK_NODE 1
+// // Total # of linked controllers, including the master.
+// #define LINK_NODES 2
+// // Link baud rate, must be the same on every controller.
+// #define LINK_BAUD 250000
+// // ms between the master's polls of its slaves.
+// #define LINK_POLL_MS 10
+// // Master only. Bit mask of the lanes timed by a slave, bit 0 is lane 1.
+// #define LINK_REMOTE_LANES 0b1100
+// // Slave only. The master's lane # timed by the slave's lane 1 sensor.
+// #define LINK_FIRST_LANE 3
+
+// // SD CARD RACE ARCHIVE
+// // Log every race to an SD card, as raw blocks. Mega2560 only, the Nano's SPI pins are in use.
+// #define SD_ARCHIVE true
+// // SD card chip select pin.
+// #define SD_CS_PIN 53
+// // 1st block of the archive, which holds the race index.
+// #define SD_ARCHIVE_FIRST_BLOCK 0
+// // # of 512 byte blocks used for race records.
+// #define SD_ARCHIVE_BLOCKS 65536
+
+// // LANE LED NAME MARQUEE
+// // ms between each scroll step of a racer name too long for its lane LED.
+// #define MARQUEE_STEP_MS 350
+// // Max # of characters of a name that are scrolled.
+// #define MARQUEE_CHARS 16
+
+// // IDLE POWER MANAGER
+// // Sleep between interrupts while in the menus, or on the finish screen.
+// #define IDLE_SLEEP false
+// // ms in the menus without a key or button press before going into deep sleep, 0 = never.
+// #define IDLE_POWER_DOWN_MS 0
+
+// // RACE CHECKPOINT
+// // Save the live race to EEPROM, to resume it after a reset.
+// #define RACE_CHECKPOINT false
+// // Min ms between checkpoints taken for new laps.
+// #define CHECKPOINT_MS 1000
+// // ms between checkpoints of the race clock alone.
+// #define CHECKPOINT_CLOCK_MS 10000
+// // # of EEPROM slots written to in turn, to spread the wear. Each slot is rewritten every CHECKPOINT_SLOTS checkpoints.
+// #define CHECKPOINT_SLOTS 8
+// // 1st EEPROM address of the checkpoint slots.
+// #define CHECKPOINT_EEPROM_ADDR 0
+
+// // WATCHDOG
+// // Reset the controller if loop() stops running. Needs the new (Optiboot) bootloader on a Nano.
+// #define WATCHDOG true
+// #define WATCHDOG_TIMEOUT WDTO_2S
+
+// // BUS ACCOUNTING
+// // Count the display bus traffic of each state, and estimate its time on the wire.
+// #define BUS_ACCOUNTING true
+// // Estimated us to shift 1 byte out to the MAX7219 chain.
+// #define BUS_LED_BYTE_US 80
+// // Max estimated ms of bus time per second in the Race state, 0 = no budget. A simulated race over it fails a soak test.
+// #define BUS_BUDGET_RACE 250
+
+// // SEASON STANDINGS
+// // Keep each racer's running points, wins, best and average lap across races, in EEPROM.
+// #define SEASON_STANDINGS false
+// // Points for a DNF, then 1st, 2nd, 3rd, and 4th place.
+// #define SEASON_POINTS {0, 10, 6, 4, 2}
+// // Number of racers kept in the season, 0 = as many as fit, 15 bytes of EEPROM each.
+// #define SEASON_ROSTER_SIZE 0
+// // 1st EEPROM address of the season, -1 = right after the race checkpoint.
+// #define SEASON_EEPROM_ADDR -1
+// #define RESULTS_SEASON_LBL "D|SEASON"
+
+// // DISPLAY COPROCESSOR
+// // Drive the lane LED bars, start light, and bargraph from a 2nd board over the UART.
+// // 1 = race controller, 2 = coprocessor, 3 = test coprocessor printing to the serial terminal.
+// #define DISPLAY_COPROC 1
+// #define COPROC_BAUD 500000
+// #define COPROC_CLOCK_MS 50
+
+// // TIMED RACE FINISH
+// // Let racers finish the lap they're on when a Timed race's time is up, and place them by how far round it they were.
+// #define FINISH_CURRENT_LAP true
+// #define FINISH_LAP_TIMEOUT 30000